@@ -107,6 +107,7 @@ public:
   P();
   P(C *o);
   P(const P<C> &p);
+  P(P<C> &&p); // takes over the reference: no incRef/decRef
   ~P();
   C *operator ->() const;
   template<class D> operator D *() const {
@@ -122,6 +123,7 @@ public:
   template<class D> bool operator !=(P<D> &p) const;
   P<C> &operator =(C *c);
   P<C> &operator =(const  P<C> &p);
+  P<C> &operator =(P<C> &&p);
   template<class D> P<C> &operator =(const P<D> &p);
 };
 
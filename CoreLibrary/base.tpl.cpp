@@ -99,6 +99,11 @@ template<class C> inline P<C>::P(const P<C> &p) : object_(p.object_) {
     object_->incRef();
 }
 
+template<class C> inline P<C>::P(P<C> &&p) : object_(p.object_) {
+
+  p.object_ = NULL;
+}
+
 template<class C> inline P<C>::~P() {
 
   if (object_)
@@ -158,6 +163,18 @@ template<class C> inline P<C> &P<C>::operator =(const P<C> &p) {
   return this->operator =((C *)p.object_);
 }
 
+template<class C> inline P<C> &P<C>::operator =(P<C> &&p) {
+
+  if (this == &p)
+    return *this;
+  if (object_)
+    object_->decRef();
+  object_ = p.object_;
+  p.object_ = NULL;
+
+  return *this;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 
 template<class C> inline _ObjectAdapter<C>::_ObjectAdapter() : _Object(), C() {
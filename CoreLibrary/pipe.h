@@ -85,10 +85,31 @@
 #ifndef core_pipe_h
 #define core_pipe_h
 
+#include "base.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <climits>
+#include <deque>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 
+
+// Two pipe engines are available; define PIPE_2 before including this file to select the second one.
+#if !defined PIPE_1 && !defined PIPE_2
 #define PIPE_1
+#endif
+
+//#define WITH_PIPE_STATS // Enable stats() in every pipe: depth, rates and wait times, registered in PipeStats.
+
+#ifdef WITH_PIPE_STATS
+#define PIPE_STATS(s) s;
+#else
+#define PIPE_STATS(s)
+#endif
 
 namespace core {
 
@@ -97,32 +118,88 @@ namespace core {
 // 1N: 1 writer, N readers
 // N1: N writers, 1 reader
 // NN: N writers, N readers
+// Items are constructed in place on push (copied, moved or emplaced) and moved out and destroyed on pop, so T may be move-only.
+// _S is the number of items per block; blocks are cache line aligned (page aligned when large enough).
+// Blocks are drawn from and returned to the BlockPool of their size, shared by all pipes; see BlockPool::TrimAll().
+// To size blocks in bytes instead, use e.g. PipeNN<T, PipeBlockBudget<T, 4096>::Size>, or 2MB for huge pages.
+template<typename T, uint32 Bytes> struct PipeBlockBudget {
 #ifdef PIPE_1
+  static const uint32 Size = (Bytes - sizeof(void *)) / sizeof(T); // the block header is a pointer
+#elif defined PIPE_2
+  static const uint32 Size = (Bytes - Memory::CacheLineSize) / (sizeof(T) + 1); // the block header fits in a cache line, plus a ready flag per item
+#endif
+};
+
+// Zero-copy access to a slot of a pipe:
+// writers construct the item in place in between reserve() and commit(), e.g. new (slot.item_) T(...);
+// readers use the item in place in between peek() and release(), which destroys it.
+// A writer (resp. reader) holds at most one slot at a time, and is to commit (resp. release) it promptly: in
+// PIPE_1 the other writers (resp. readers) wait meanwhile, in PIPE_2 the readers of that slot do.
+template<typename T> class PipeSlot {
+public:
+  T *item_;
+  void *block_; // for the pipe's own use
+  uint32 index_;
+};
+
+#ifdef PIPE_1
+// Pipe11 is lock-free: the producer owns tail_ and last_, the consumer owns head_ and first_.
+// Items are published through the lightweight semaphore (release on push, acquire on pop): the
+// OS semaphore is only used when the pipe is empty.
+// Blocks are recycled through the shared BlockPool: the writer allocates them, the reader releases them.
+// The other variants serialize their multiple writers and/or readers on top of this.
 template<typename T, uint32 _S> class Pipe11 :
-  public Semaphore,
-  public CriticalSection {
+  public LightweightSemaphore {
 private:
-  class Block {
+  class alignas(Memory::CacheLineSize) Block {
   public:
-    T buffer_[_S * sizeof(T)];
-    Block *next_;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type buffer_[_S]; // raw storage: only the slots between the reader and the writer hold items
+    std::atomic<Block *> next_;
+    T *slot(int32 index) { return reinterpret_cast<T *>(buffer_ + index); }
     Block(Block *prev) : next_(NULL) { if (prev) prev->next_ = this; }
     ~Block() { if (next_) delete next_; }
+    static BlockPool *Pool() { static BlockPool *pool = BlockPool::Get(sizeof(Block)); return pool; }
+    static void *operator new(size_t) { return Pool()->allocate(); }
+    static void operator delete(void *p) { Pool()->deallocate(p); }
   };
   int32 head_;
   int32 tail_;
   Block *first_;
   Block *last_;
-  Block *spare_;
+  void _grow(); // appends a block for the writer
+  void _shrink(); // moves the reader to the next block
 protected:
-  void _clear();
+#ifdef WITH_PIPE_STATS
+  PipeStats stats_{ this };
+#endif
+  void _clear(); // reader side
   T _pop();
+  void _pop(T *out, uint32 n); // moves whole runs across blocks
+  void _peek(PipeSlot<T> &slot);
 public:
   Pipe11();
   ~Pipe11();
-  void clear();
+  void clear(); // to be called by the reader
   void push(T &t); // increases the size as necessary
+  void push(T &&t);
+  template<typename... Args> void emplace(Args &&... args); // constructs the item in the pipe
+  void push(const T *items, uint32 n); // publishes the n items at once
   T pop(); // decreases the size as necessary
+  uint32 pop(T *out, uint32 max, uint32 timeout = LightweightSemaphore::Infinite); // waits for at least one item (timeout in ms), then takes up to max; returns the number of items popped
+  bool try_pop(T &t); // returns false if the pipe is empty
+  bool pop_until(T &t, Timestamp deadline); // deadline on the Time::Get() clock; returns false if timedout
+  template<class Rep, class Period> bool pop_for(T &t, const std::chrono::duration<Rep, Period> &timeout) { return pop_until(t, Time::Get() + std::chrono::duration_cast<std::chrono::microseconds>(timeout)); }
+  PipeSlot<T> reserve(); // the raw slot of the next item, published by commit()
+  void commit(PipeSlot<T> &slot);
+  PipeSlot<T> peek(); // waits for the head item, destroyed by release()
+  bool try_peek(PipeSlot<T> &slot); // returns false if the pipe is empty
+  void release(PipeSlot<T> &slot);
+  using LightweightSemaphore::release;
+
+  static uint32 BlockBytes(); // memory taken by a block, i.e. BlockBytes()/_S per queued item
+#ifdef WITH_PIPE_STATS
+  PipeStats &stats() { return stats_; }
+#endif
 };
 
 template<typename T, uint32 _S> class Pipe1N :
@@ -134,6 +211,13 @@ public:
   ~Pipe1N();
   void clear();
   T pop();
+  uint32 pop(T *out, uint32 max, uint32 timeout = LightweightSemaphore::Infinite);
+  bool try_pop(T &t);
+  bool pop_until(T &t, Timestamp deadline);
+  template<class Rep, class Period> bool pop_for(T &t, const std::chrono::duration<Rep, Period> &timeout) { return pop_until(t, Time::Get() + std::chrono::duration_cast<std::chrono::microseconds>(timeout)); }
+  PipeSlot<T> peek(); // holds the readers until release()
+  bool try_peek(PipeSlot<T> &slot);
+  void release(PipeSlot<T> &slot);
 };
 
 template<typename T, uint32 _S> class PipeN1 :
@@ -145,6 +229,11 @@ public:
   ~PipeN1();
   void clear();
   void push(T &t);
+  void push(T &&t);
+  template<typename... Args> void emplace(Args &&... args);
+  void push(const T *items, uint32 n);
+  PipeSlot<T> reserve(); // holds the writers until commit()
+  void commit(PipeSlot<T> &slot);
 };
 
 template<typename T, uint32 _S> class PipeNN :
@@ -157,15 +246,77 @@ public:
   ~PipeNN();
   void clear();
   void push(T &t);
+  void push(T &&t);
+  template<typename... Args> void emplace(Args &&... args);
+  void push(const T *items, uint32 n);
 
   /**
    * Pop the head item.
    * \param waitForItem (optional) If true and the pipe is empty, block until
    * another thread adds an item with push(). If false and the pipe is empty,
-   * return NULL immediately.If omitted, then wait for an item.
-   * \return The popped item, or NULL if waitForItem is false and the pipe is empty.
+   * return T() (NULL for pointers) immediately. If omitted, then wait for an item.
+   * \return The popped item, or T() if waitForItem is false and the pipe is empty.
    */
   T pop(bool waitForItem = true);
+
+  /**
+   * Pop up to max items in one go.
+   * \param out Receives the items, in order.
+   * \param max The capacity of out.
+   * \param timeout (optional) How long to wait in ms for the first item. If 0,
+   * return immediately when the pipe is empty. If omitted, then wait for an item.
+   * \return The number of items popped, or 0 if timedout.
+   */
+  uint32 pop(T *out, uint32 max, uint32 timeout = LightweightSemaphore::Infinite);
+
+  /**
+   * Pop the head item if there is one, without blocking.
+   * \param t Receives the item.
+   * \return false if the pipe is empty.
+   */
+  bool try_pop(T &t);
+
+  /**
+   * Pop the head item, waiting until the deadline at most.
+   * \param t Receives the item.
+   * \param deadline On the (monotonic) Time::Get() clock.
+   * \return false if timedout.
+   */
+  bool pop_until(T &t, Timestamp deadline);
+
+  /**
+   * Pop the head item, waiting for the duration at most.
+   * \return false if timedout.
+   */
+  template<class Rep, class Period> bool pop_for(T &t, const std::chrono::duration<Rep, Period> &timeout) { return pop_until(t, Time::Get() + std::chrono::duration_cast<std::chrono::microseconds>(timeout)); }
+
+  /**
+   * Reserve the slot of the next item, holding the other writers until commit().
+   * \return The slot, where to construct the item in place.
+   */
+  PipeSlot<T> reserve();
+
+  /**
+   * Publish the item constructed in the reserved slot.
+   */
+  void commit(PipeSlot<T> &slot);
+
+  /**
+   * Wait for the head item, holding the other readers until release().
+   * \return The slot, where to read the item in place.
+   */
+  PipeSlot<T> peek();
+
+  /**
+   * Peek at the head item if there is one, without blocking.
+   * \return false if the pipe is empty.
+   */
+  bool try_peek(PipeSlot<T> &slot);
+
+  /**
+   * Destroy the item peeked at.
+   */
+  void release(PipeSlot<T> &slot);
 };
 #elif defined PIPE_2
 template<typename T, uint32 _S, class Pipe> class Push1;
@@ -174,110 +325,565 @@ template<typename T, uint32 _S, class Pipe> class Pop1;
 template<typename T, uint32 _S, class Pipe> class PopN;
 
 // a Pipe<T,_S> is a linked list of blocks containing _S objects of type T
-// push() adds an object at the tail of the last block and moves the tail forward; when the tail reaches the end of the last block, a new block is appended to the list
-// pop() moves the head forward and returns the object at this location; when the head reaches the end of the first block, this block is deallocated
-// Synchronization between readers and writers is lock-free under no contention (reqCount), and uses a lock (Semaphore::) under contention
-// single writer pipes can use an int32 tail, whereas multiple writer versions require int32 volatile tail; idem for readers
-// The Head and Tail argument is meant to allow the parameterizing of heads and tails
-// Push and Pop are functors tailored to the multiplicity of resp. the read and write threads
-// P is the actual pipe class (e.g. Pipe11, etc.)
-template<typename T, uint32 _S, typename Head, typename Tail, class P, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> class Pipe :
-  public Semaphore {
-  template<typename T, uint32 _S, class Pipe> friend class Push1;
-  template<typename T, uint32 _S, class Pipe> friend class PushN;
-  template<typename T, uint32 _S, class Pipe> friend class Pop1;
-  template<typename T, uint32 _S, class Pipe> friend class PopN;
+// Every push and pop takes a ticket (a 64 bits sequence number); ticket t lives in the block whose base_ is t-t%_S
+// push() writes at its ticket and publishes the item; the writer of the first ticket past the last block appends a new block
+// pop() waits for a published item, then reads at its ticket; the reader completing a block retires it
+// Synchronization between readers and writers is lock-free (LightweightSemaphore::), and readers only sleep when the pipe is empty
+// Blocks are retired and recycled under blockCS_, i.e. once per _S items; a thread holding a stale block pointer reads its base_ to
+// detect that the block has been recycled, so retired blocks stay in the pipe while a thread may be walking the list (walkers_):
+// the pipe keeps FreeReserve of them for reuse, and returns the others to the BlockPool once no thread is walking
+// single writer pipes use a uint64 tail, whereas multiple writer versions require an atomic tail; idem for readers
+// The Head and Tail arguments are meant to allow the parameterizing of heads and tails
+// Push and Pop are functors tailored to the multiplicity of resp. the write and read threads
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> class Pipe :
+  public LightweightSemaphore {
+  template<typename, uint32, class> friend class Push1;
+  template<typename, uint32, class> friend class PushN;
+  template<typename, uint32, class> friend class Pop1;
+  template<typename, uint32, class> friend class PopN;
 protected:
-  class Block {
+  class alignas(Memory::CacheLineSize) Block {
   public:
-    T buffer_[_S];
-    Block *next_;
-    Block(Block *prev) : next_(NULL) { if (prev) prev->next_ = this; }
-    ~Block() { if (next_) delete next_; }
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type buffer_[_S]; // raw storage: items are constructed by writers and destroyed by readers
+    std::atomic<uint8> ready_[Push<T, _S, Pipe>::Ordered ? 1 : _S]; // set by writers when they are not ordered, cleared by readers
+    std::atomic<uint64> base_; // ticket of buffer_[0]
+    std::atomic_uint32_t done_; // amount of slots read
+    std::atomic<Block *> next_; // links the free blocks too
+    Block(uint64 base);
+    T *slot(uint32 index) { return reinterpret_cast<T *>(buffer_ + index); }
+    static BlockPool *Pool() { static BlockPool *pool = BlockPool::Get(sizeof(Block)); return pool; }
+    static void *operator new(size_t) { return Pool()->allocate(); }
+    static void operator delete(void *p) { Pool()->deallocate(p); }
   };
-  Block *first_;
-  Block *last_;
-  Block *spare_; // pipes always retain a spare block: if a block is to be deallocated and there is no spare, it becomes the spare
-
-  Head head_; // starts at -1
-  Tail tail_; // starts at 0
-  int32 volatile waitingList_; // amount of readers that have to wait, negative value indicate free lunch
+  Head head_; // next ticket to read
+  Tail tail_; // next ticket to write
+  static const uint32 FreeReserve = 2; // retired blocks kept for reuse
+  std::atomic<Block *> first_;
+  std::atomic<Block *> last_;
+  Block *free_; // recycled blocks
+  uint32 freeCount_;
+  CriticalSection blockCS_; // guards the retirement of first_, free_ and freeCount_
+  std::atomic_int32_t walkers_; // threads that may hold a pointer to a retired block
+#ifdef WITH_PIPE_STATS
+  PipeStats stats_{ this };
+#endif
 
-  Push<T, _S, P> *_push;
-  Pop<T, _S, P> *_pop;
+  Push<T, _S, Pipe> push_;
+  Pop<T, _S, Pipe> pop_;
 
-  void shrink(); // deallocates the first block when head_ reaches its end
-  void grow(); // allocate a new last block when tail_ reaches its end
+  Block *grow(Block *last, uint64 base); // appends a block after last when a writer gets the ticket base
+  void shrink(); // retires the completed blocks at the head, and returns the surplus to the BlockPool when no thread is walking
+  Block *locate(uint64 ticket); // walks from first_; returns NULL if a recycled block was met
+  Block *locateTail(uint64 ticket); // for multiple writers: appends the block of ticket if needed
+  T *readable(Block *b, uint32 index); // waits for the writer of the slot
+  void done(Block *b, uint32 n); // n slots of b have been read
+  T read(Block *b, uint32 index);
+  void read(Block *b, uint32 index, T *out, uint32 n); // n slots in the same block
 
   Pipe();
 public:
   ~Pipe();
+  void clear();
   void push(T &t);
+  void push(T &&t);
+  template<typename... Args> void emplace(Args &&... args); // constructs the item in the pipe
+  void push(const T *items, uint32 n); // publishes the n items at once
   T pop();
+  uint32 pop(T *out, uint32 max, uint32 timeout = LightweightSemaphore::Infinite); // waits for at least one item (timeout in ms), then takes up to max; returns the number of items popped
+  bool try_pop(T &t); // returns false if the pipe is empty
+  bool pop_until(T &t, Timestamp deadline); // deadline on the Time::Get() clock; returns false if timedout
+  template<class Rep, class Period> bool pop_for(T &t, const std::chrono::duration<Rep, Period> &timeout) { return pop_until(t, Time::Get() + std::chrono::duration_cast<std::chrono::microseconds>(timeout)); }
+  PipeSlot<T> reserve(); // the raw slot of the next item, published by commit()
+  void commit(PipeSlot<T> &slot);
+  PipeSlot<T> peek(); // waits for the head item, destroyed by release()
+  bool try_peek(PipeSlot<T> &slot); // returns false if the pipe is empty
+  void release(PipeSlot<T> &slot);
+  using LightweightSemaphore::release;
+
+  static uint32 BlockBytes(); // memory taken by a block, i.e. BlockBytes()/_S per queued item
+#ifdef WITH_PIPE_STATS
+  PipeStats &stats() { return stats_; }
+#endif
 };
 
 template<class Pipe> class PipeFunctor {
 protected:
-  Pipe &const pipe;
+  Pipe &pipe_;
   PipeFunctor(Pipe &p);
 };
 
 template<typename T, uint32 _S, class Pipe> class Push1 :
   public PipeFunctor<Pipe> {
 public:
+  static const bool Ordered = true; // items are published in ticket order
   Push1(Pipe &p);
-  void operator ()(T &t);
+  template<typename... Args> void emplace(Args &&... args);
+  void operator ()(const T *items, uint32 n);
+  void reserve(PipeSlot<T> &slot);
+  void commit(PipeSlot<T> &slot);
 };
 
 template<typename T, uint32 _S, class Pipe> class PushN :
-  public PipeFunctor<Pipe>,
-  public Semaphore {
+  public PipeFunctor<Pipe> {
 public:
+  static const bool Ordered = false;
   PushN(Pipe &p);
-  void operator ()(T &t);
+  template<typename... Args> void emplace(Args &&... args);
+  void operator ()(const T *items, uint32 n);
+  void reserve(PipeSlot<T> &slot);
+  void commit(PipeSlot<T> &slot);
 };
 
 template<typename T, uint32 _S, class Pipe> class Pop1 :
   public PipeFunctor<Pipe> {
+private:
+  typename Pipe::Block *block_; // holds the last ticket read
+  uint64 base_;
+  void locate(uint64 ticket);
 public:
   Pop1(Pipe &p);
-  T operator ()();
+  T operator ()(); // to be called after an item has been acquired
+  void operator ()(T *out, uint32 n); // to be called after n items have been acquired
+  void peek(PipeSlot<T> &slot); // to be called after an item has been acquired
 };
 
 template<typename T, uint32 _S, class Pipe> class PopN :
-  public PipeFunctor<Pipe>,
-  public Semaphore {
+  public PipeFunctor<Pipe> {
 public:
   PopN(Pipe &p);
-  T operator ()();
+  T operator ()(); // to be called after an item has been acquired
+  void operator ()(T *out, uint32 n); // to be called after n items have been acquired
+  void peek(PipeSlot<T> &slot); // to be called after an item has been acquired
 };
 
 template<typename T, uint32 S> class Pipe11 :
-  public Pipe<T, S, int32, int32, Pipe11<T, S>, Push1, Pop1> {
+  public Pipe<T, S, uint64, uint64, Push1, Pop1> {
 public:
   Pipe11();
   ~Pipe11();
 };
 
 template<typename T, uint32 S> class Pipe1N :
-  public Pipe<T, S, int32, int32 volatile, Pipe1N<T, S>, Push1, PopN> {
+  public Pipe<T, S, std::atomic<uint64>, uint64, Push1, PopN> {
 public:
   Pipe1N();
   ~Pipe1N();
 };
 
 template<typename T, uint32 S> class PipeN1 :
-  public Pipe<T, S, int32 volatile, int32, PipeN1<T, S>, PushN, Pop1> {
+  public Pipe<T, S, uint64, std::atomic<uint64>, PushN, Pop1> {
 public:
   PipeN1();
   ~PipeN1();
 };
 
 template<typename T, uint32 S> class PipeNN :
-  public Pipe<T, S, int32 volatile, int32 volatile, PipeNN<T, S>, PushN, PopN> {
+  public Pipe<T, S, std::atomic<uint64>, std::atomic<uint64>, PushN, PopN> {
 public:
   PipeNN();
   ~PipeNN();
+
+  /**
+   * Pop the head item.
+   * \param waitForItem (optional) If true and the pipe is empty, block until
+   * another thread adds an item with push(). If false and the pipe is empty,
+   * return T() (NULL for pointers) immediately. If omitted, then wait for an item.
+   * \return The popped item, or T() if waitForItem is false and the pipe is empty.
+   */
+  T pop(bool waitForItem = true);
+
+  /**
+   * Pop up to max items in one go.
+   * \param out Receives the items, in order.
+   * \param max The capacity of out.
+   * \param timeout (optional) How long to wait in ms for the first item. If 0,
+   * return immediately when the pipe is empty. If omitted, then wait for an item.
+   * \return The number of items popped, or 0 if timedout.
+   */
+  uint32 pop(T *out, uint32 max, uint32 timeout = LightweightSemaphore::Infinite);
+};
+#endif
+
+// A BoundedPipe holds at most capacity items; P is one of the variants above.
+// Writers take room from a lightweight semaphore before pushing, and readers give it back after popping:
+// this costs one atomic operation on each side unless the pipe is full, in which case writers sleep.
+// The size reaching the high watermark raises isHigh() and calls onHighWatermark(); falling back to the low
+// watermark clears it and calls onLowWatermark(). The hooks are called by the writer/reader causing the change.
+// The watermarks are kept to low < high <= capacity: high defaults to capacity, and is clamped to it; low defaults to
+// min(capacity / 2, high - 1), and is lowered to high - 1 if not below high.
+template<typename T, uint32 _S, template<typename, uint32> class P> class BoundedPipe :
+  public P<T, _S> {
+private:
+  LightweightSemaphore room_;
+  std::atomic_int32_t size_;
+  std::atomic_bool high_;
+  const int32 highWatermark_;
+  const int32 lowWatermark_;
+  static uint32 High(uint32 capacity, uint32 highWatermark);
+  static uint32 Low(uint32 capacity, uint32 highWatermark, uint32 lowWatermark);
+  void grown(uint32 n);
+  void shrunk(uint32 n);
+protected:
+  virtual void onHighWatermark();
+  virtual void onLowWatermark();
+public:
+  BoundedPipe(uint32 capacity, uint32 highWatermark = 0, uint32 lowWatermark = 0); // 0: default watermark (see above)
+  virtual ~BoundedPipe();
+  void clear();
+  void push(T &t); // waits for room
+  void push(T &&t);
+  template<typename... Args> void emplace(Args &&... args);
+  bool push(T &t, uint32 timeout); // timeout in ms; returns true if timedout
+  bool try_push(T &t); // returns false if the pipe is full
+  uint32 push(const T *items, uint32 n, uint32 timeout = LightweightSemaphore::Infinite); // waits for room for at least one item, then pushes as many as fit; returns the number of items pushed
+  T pop();
+  uint32 pop(T *out, uint32 max, uint32 timeout = LightweightSemaphore::Infinite);
+  bool try_pop(T &t);
+  bool pop_until(T &t, Timestamp deadline);
+  template<class Rep, class Period> bool pop_for(T &t, const std::chrono::duration<Rep, Period> &timeout) { return pop_until(t, Time::Get() + std::chrono::duration_cast<std::chrono::microseconds>(timeout)); }
+  PipeSlot<T> reserve(); // waits for room
+  void commit(PipeSlot<T> &slot);
+  PipeSlot<T> peek();
+  bool try_peek(PipeSlot<T> &slot);
+  void release(PipeSlot<T> &slot);
+  uint32 size() const;
+  bool isHigh() const;
+};
+
+// A PriorityPipe multiplexes _L lanes, each a P<T,_S> (PipeNN for several readers, PipeN1 for one), behind one semaphore counting
+// the items of all lanes: readers sleep on it only, and wake up for any lane.
+// Strict: readers take from the lowest lane holding an item; lane 0 comes first.
+// Weighted: lane i gets weights[i] turns in a cycle of sum(weights) pops, interleaved; a turn on an empty lane falls back to the
+// lowest lane holding an item, so that no turn is lost waiting.
+template<typename T, uint32 _S, uint32 _L, template<typename, uint32> class P = PipeNN> class PriorityPipe :
+  public LightweightSemaphore {
+private:
+  P<T, _S> lanes_[_L];
+  std::vector<uint32> schedule_; // lane per turn; empty when strict
+  std::atomic_uint32_t turn_;
+  P<T, _S> &_peek(PipeSlot<T> &slot); // to be called after an item has been acquired; returns the lane holding it
+  void _pop(T &t); // to be called after an item has been acquired
+public:
+  PriorityPipe(const uint32 *weights = NULL); // _L weights, NULL for strict priorities
+  ~PriorityPipe();
+  void clear();
+  void push(T &t, uint32 lane);
+  void push(T &&t, uint32 lane);
+  template<typename... Args> void emplace(uint32 lane, Args &&... args);
+  T pop();
+  bool try_pop(T &t);
+  bool pop_until(T &t, Timestamp deadline);
+  template<class Rep, class Period> bool pop_for(T &t, const std::chrono::duration<Rep, Period> &timeout) { return pop_until(t, Time::Get() + std::chrono::duration_cast<std::chrono::microseconds>(timeout)); }
+  uint32 size(uint32 lane) const; // items not yet claimed by a reader
+};
+
+// A ShardedPipe spreads its writers over _N shards: a writer thread always pushes to the same shard, so that the items of a
+// writer are popped in order, while writers on different shards never contend. A shard is a plain queue of blocks of _S items
+// guarded by a critical section, with no semaphore of its own: readers sleep on the one semaphore counting the items of all shards,
+// and drain the shards round-robin, skipping those whose count is 0 without locking them.
+template<typename T, uint32 _S, uint32 _N = 16> class ShardedPipe :
+  public LightweightSemaphore {
+private:
+  class alignas(Memory::CacheLineSize) Shard { // all but count_ are guarded by cs_
+  public:
+    class Block {
+    public:
+      typename std::aligned_storage<sizeof(T), alignof(T)>::type buffer_[_S];
+      Block *next_;
+      T *slot(uint32 index) { return reinterpret_cast<T *>(buffer_ + index); }
+      Block() : next_(NULL) {}
+    };
+    CriticalSection cs_;
+    Block *first_;
+    Block *last_;
+    Block *spare_; // the last block emptied, kept for reuse
+    uint32 head_; // in first_
+    uint32 tail_; // in last_
+    std::atomic_uint32_t count_; // written under cs_, read without
+    Shard();
+    ~Shard();
+    template<typename... Args> void emplace(Args &&... args);
+    T *front(); // the shard is not empty
+    void pop_front();
+  };
+  Shard *shards_; // _N, allocated apart so that the pipe itself needs no extended alignment
+  std::atomic_uint32_t next_; // shard where the next scan starts
+  Shard &shard(); // of the calling writer
+  Shard &take(); // to be called after an item has been acquired; returns a shard holding an item, entered
+  void _pop(T &t); // to be called after an item has been acquired
+  void _pop(T *out, uint32 n); // to be called after n items have been acquired
+public:
+  ShardedPipe();
+  ~ShardedPipe();
+  void clear();
+  void push(T &t);
+  void push(T &&t);
+  template<typename... Args> void emplace(Args &&... args);
+  void push(const T *items, uint32 n); // the n items stay together, in one shard
+  T pop();
+  uint32 pop(T *out, uint32 max, uint32 timeout = LightweightSemaphore::Infinite); // waits for at least one item (timeout in ms), then takes up to max; returns the number of items popped
+  bool try_pop(T &t);
+  bool pop_until(T &t, Timestamp deadline);
+  template<class Rep, class Period> bool pop_for(T &t, const std::chrono::duration<Rep, Period> &timeout) { return pop_until(t, Time::Get() + std::chrono::duration_cast<std::chrono::microseconds>(timeout)); }
+};
+
+// A BroadcastPipe hands every item to all its consumers: one writer stores each item once in a ring of _S (a power of 2) slots,
+// and each of at most _C consumers reads it in turn, at its own pace, following its own sequence. T is default constructible and
+// copy assignable: the slots are reused as the ring wraps. Consumers subscribe() before reading, from the next item pushed on.
+// When the slowest consumer lags a whole ring behind, the writer either waits for it (Backpressure), or drops it (DropSlow):
+// a dropped consumer's reads fail until it unsubscribes. Only sleeping consumers are woken up, and they are checked only when some sleep.
+template<typename T, uint32 _S, uint32 _C = 16> class BroadcastPipe {
+  static_assert(_S && !(_S & (_S - 1)), "the size of a BroadcastPipe is a power of 2");
+public:
+  typedef enum {
+    Backpressure = 0,
+    DropSlow = 1
+  } Policy;
+  class alignas(Memory::CacheLineSize) Consumer {
+    friend class BroadcastPipe;
+  private:
+    BroadcastPipe *pipe_;
+    std::atomic<uint64> sequence_; // next item to read
+    std::atomic_bool active_; // subscribed
+    std::atomic_bool dropped_;
+    std::atomic_bool busy_; // copying an item, which the writer may not overwrite (DropSlow only)
+    std::atomic_bool sleeping_;
+    Semaphore wake_;
+    Consumer();
+    bool read(T &t); // returns false if there is no item to read
+  public:
+    bool pop(T &t); // waits for an item; returns false if dropped
+    bool try_pop(T &t);
+    bool pop_until(T &t, Timestamp deadline);
+    template<class Rep, class Period> bool pop_for(T &t, const std::chrono::duration<Rep, Period> &timeout) { return pop_until(t, Time::Get() + std::chrono::duration_cast<std::chrono::microseconds>(timeout)); }
+    bool dropped() const;
+    uint64 lag() const; // items pushed and not read yet
+  };
+private:
+  const Policy policy_;
+  T *ring_;
+  alignas(Memory::CacheLineSize) std::atomic<uint64> cursor_; // items published
+  uint64 gating_; // lower bound of the sequences of the active consumers, as last computed by the writer
+  std::atomic_bool waiting_; // the writer is waiting for room (Backpressure)
+  Semaphore room_;
+  alignas(Memory::CacheLineSize) std::atomic_int32_t sleepers_; // consumers
+  Consumer consumers_[_C];
+  CriticalSection subscriptionCS_;
+  uint64 gate(uint64 sequence); // the sequence of the slowest active consumer, sequence if none; drops those a ring behind (DropSlow)
+  bool room(bool wait); // makes sure the slot of the next item is free; returns false if it is not and wait is false
+  void publish();
+  void advanced(); // a consumer has moved on
+public:
+  BroadcastPipe(Policy policy = Backpressure);
+  ~BroadcastPipe();
+  Consumer *subscribe(); // returns NULL if _C consumers are subscribed already
+  void unsubscribe(Consumer *c);
+  void push(const T &t);
+  void push(T &&t);
+  bool try_push(const T &t); // returns false if a consumer lags a whole ring behind (Backpressure)
+  uint64 pushed() const;
+};
+
+// A DelayPipe holds each item until its deadline (on the Time::Get() clock): readers pop the item with the earliest deadline once it
+// has passed, and items with the same deadline in the order they were pushed. The items are kept in a binary heap. Readers sleep
+// until the earliest deadline, or until a push brings an earlier one; they are not woken up otherwise.
+template<typename T> class DelayPipe {
+private:
+  class Entry {
+  public:
+    Timestamp deadline_;
+    uint64 order_; // among the items due at the same time
+    T item_;
+    Entry(Timestamp deadline, uint64 order, const T &t) : deadline_(deadline), order_(order), item_(t) {}
+    Entry(Timestamp deadline, uint64 order, T &&t) : deadline_(deadline), order_(order), item_(std::move(t)) {}
+    bool operator <(const Entry &e) const { return deadline_ > e.deadline_ || (deadline_ == e.deadline_ && order_ > e.order_); } // the earliest on top of the heap
+  };
+  std::vector<Entry> heap_;
+  uint64 pushes_;
+  uint32 sleepers_;
+  CriticalSection cs_; // guards the above
+  Semaphore wake_; // released for a sleeper when a push brings an earlier deadline
+  void pushed(); // to be called in cs_ after an item has been added to heap_
+  bool wait(Timestamp deadline); // returns true, in cs_, when an item is due; returns false, out of cs_, if timedout
+  T take(); // to be called in cs_ when an item is due; leaves cs_
+public:
+  DelayPipe();
+  ~DelayPipe();
+  void clear();
+  void push(const T &t, Timestamp deadline);
+  void push(T &&t, Timestamp deadline);
+  template<class Rep, class Period> void push_in(T t, const std::chrono::duration<Rep, Period> &delay) { push(std::move(t), Time::Get() + std::chrono::duration_cast<std::chrono::microseconds>(delay)); }
+  T pop(); // waits for the earliest deadline to pass
+  bool try_pop(T &t); // returns false if no item is due
+  bool pop_until(T &t, Timestamp deadline);
+  template<class Rep, class Period> bool pop_for(T &t, const std::chrono::duration<Rep, Period> &timeout) { return pop_until(t, Time::Get() + std::chrono::duration_cast<std::chrono::microseconds>(timeout)); }
+  uint32 size(); // items held, due or not
+  Timestamp next(); // the earliest deadline; Timestamp::max() if empty
+};
+
+// A CoalescingPipe holds the last value pushed per key: a push for a key still waiting replaces its value in place, keeping its
+// position in the pipe, so that readers process at most one update per distinct key, however fast the updates come.
+// Keys are popped in the order they were first pushed since their last pop.
+template<typename K, typename T, class Hash = std::hash<K> > class CoalescingPipe :
+  public LightweightSemaphore {
+private:
+  std::unordered_map<K, T, Hash> values_;
+  std::deque<K> keys_; // in order
+  uint64 coalesced_;
+  CriticalSection cs_; // guards the above
+  void take(K &key, T &t); // to be called after a key has been acquired
+public:
+  CoalescingPipe();
+  ~CoalescingPipe();
+  void clear();
+  bool push(const K &key, const T &t); // returns false if it replaced a value waiting
+  bool push(const K &key, T &&t);
+  void pop(K &key, T &t);
+  bool try_pop(K &key, T &t);
+  bool pop_until(K &key, T &t, Timestamp deadline);
+  template<class Rep, class Period> bool pop_for(K &key, T &t, const std::chrono::duration<Rep, Period> &timeout) { return pop_until(key, t, Time::Get() + std::chrono::duration_cast<std::chrono::microseconds>(timeout)); }
+  uint32 size(); // keys waiting
+  uint64 coalesced(); // updates replaced before being popped
+};
+
+// Link of the objects carried by an IntrusivePipeN1: derive the messages from both _Object and PipeLink.
+// An object is in one such pipe at a time.
+class PipeLink {
+  template<class C> friend class IntrusivePipeN1;
+private:
+  std::atomic<PipeLink *> next_;
+public:
+  PipeLink() : next_(NULL) {}
+};
+
+// An IntrusivePipeN1 carries _Object-derived messages from many writers to one reader, linking them through their own PipeLink
+// (Vyukov's MPSC queue): no block is allocated, and a push is one atomic exchange (plus the release of the semaphore counting the
+// items). The pipe holds a reference to a message from push until pop.
+// A pop may find the last message pushed not linked yet, its writer being between the exchange and the link: the reader then yields.
+template<class C> class IntrusivePipeN1 :
+  public LightweightSemaphore {
+private:
+  std::atomic<PipeLink *> head_; // last pushed, shared by the writers
+  alignas(Memory::CacheLineSize) PipeLink *tail_; // next to pop, owned by the reader
+  PipeLink stub_; // stands for the empty pipe
+  void link(PipeLink *l);
+  C *_pop(); // NULL if none, or if the next one is not linked yet
+  C *take(); // to be called after an item has been acquired
+public:
+  IntrusivePipeN1();
+  ~IntrusivePipeN1();
+  void clear(); // by the reader
+  void push(C *c);
+  void push(const P<C> &p) { push((C *)p); }
+  P<C> pop();
+  bool try_pop(P<C> &p);
+  bool pop_until(P<C> &p, Timestamp deadline);
+  template<class Rep, class Period> bool pop_for(P<C> &p, const std::chrono::duration<Rep, Period> &timeout) { return pop_until(p, Time::Get() + std::chrono::duration_cast<std::chrono::microseconds>(timeout)); }
+};
+
+#if defined LINUX // SpillPipe and SharedPipe are Linux only, as SpillFile and SharedMemory (utils.h)
+// A SpillPipe is a P<T,_S> (one of the variants above) whose overflow goes to disk, for trivially copyable items: past watermark
+// items held in memory, writers copy the items to a buffer of _S items, appended to the spill file at path once full. Readers take
+// the items in memory first, then those spilled, reading the file back chunk by chunk through mappings, then those in the buffer;
+// once all is drained, the file is truncated and writers push to memory again. Memory thus stays bounded by the watermark plus a few
+// chunks while readers fall behind, and no item is lost. Should the file fail, the chunks are kept in memory instead, and a chunk
+// that cannot be mapped back is read into memory. Only a chunk the file cannot give back at all is lost: the error is reported,
+// lost() counts its items, and the pipe stops counting them, so that readers do not wait for them.
+template<typename T, uint32 _S, template<typename, uint32> class P = PipeNN> class SpillPipe :
+  public LightweightSemaphore {
+  static_assert(std::is_trivially_copyable<T>::value, "SpillPipe items are written to disk as is");
+private:
+  P<T, _S> memory_;
+  const int32 watermark_;
+  std::atomic_bool spilling_; // writers append to tail_
+  CriticalSection spillCS_; // guards the following
+  SpillFile file_;
+  std::deque<T *> chunks_; // spilled, in order: NULL for a chunk in the file, or a chunk the file could not take
+  T *tail_;
+  uint32 tailCount_;
+  T *buffer_; // tail_ taken over by the readers
+  const T *front_; // the chunk being read: mapped, one of chunks_, or buffer_
+  bool mapped_;
+  uint32 frontCount_;
+  uint32 frontRead_;
+  uint64 spilled_; // items out of memory_
+  uint64 lost_; // items of the chunks the file could not give back
+  std::atomic_uint32_t owed_; // units of lost items acquired by readers, who are to find no item for them
+  void spill(const T &t);
+  bool next(); // moves front_ to the next chunk; returns false when all has been read
+  void drop(); // done with front_
+  void lose(); // gives up on the oldest chunk in the file
+  bool _pop(T *t); // to be called after an item has been acquired; copy-constructs it at t, raw storage or a T (trivially destructible); returns false if the item was lost
+public:
+  SpillPipe(const char *path, uint32 watermark);
+  ~SpillPipe();
+  void push(const T &t);
+  T pop();
+  bool try_pop(T &t);
+  bool pop_until(T &t, Timestamp deadline);
+  template<class Rep, class Period> bool pop_for(T &t, const std::chrono::duration<Rep, Period> &timeout) { return pop_until(t, Time::Get() + std::chrono::duration_cast<std::chrono::microseconds>(timeout)); }
+  uint64 spilled(); // items out of memory
+  uint64 lost(); // items given up with the chunks the file could not give back
+};
+
+// A SharedPipe connects processes: its ring of _S (a power of 2) items lives in a named SharedMemory region that one process
+// create()s and the others open(), each as a Writer or a Reader; any number of each may attach. Items are trivially copyable,
+// and are copied in and out of the ring; writers wait for room when the ring is full.
+// Waits give up when the other side is gone, i.e. when all its processes have detached or died: readers still get the items
+// left in the ring, then pop() returns false. A process dying in the middle of a push or a pop may leave its slot unusable: the
+// push or pop of the other side waiting on that slot gives up, and returns false, once that side is gone or past its deadline.
+template<typename T, uint32 _S> class SharedPipe {
+  static_assert(std::is_trivially_copyable<T>::value, "SharedPipe items are copied across processes");
+  static_assert(_S && !(_S & (_S - 1)), "the size of a SharedPipe is a power of 2");
+public:
+  typedef enum {
+    Writer = 0,
+    Reader = 1
+  } Side;
+private:
+  static const uint32 Magic = 0x50495045; // set by the creator once the region is initialized
+  static const uint32 PeerCheckPeriod = 100; // ms between two checks of the other side while waiting
+  class Cell {
+  public:
+    std::atomic<uint64> sequence_; // ticket of the item held plus one; ticket of the next item to write there when empty
+    T item_;
+  };
+  class Header {
+  public:
+    std::atomic_uint32_t magic_;
+    uint32 size_; // _S
+    uint32 itemSize_;
+    alignas(Memory::CacheLineSize) std::atomic<uint64> tail_; // next ticket to write
+    alignas(Memory::CacheLineSize) std::atomic<uint64> head_; // next ticket to read
+    alignas(Memory::CacheLineSize) SharedSemaphore items_;
+    SharedSemaphore room_;
+    SharedPeers peers_[2]; // per side
+  };
+  SharedMemory memory_;
+  Header *header_;
+  Cell *cells_;
+  Side side_;
+  SharedPipe *attach(Side side);
+  bool wait(SharedSemaphore &s, Timestamp deadline); // returns false if timedout or if the other side is gone
+  bool ready(Cell &cell, uint64 sequence, Timestamp deadline); // waits for the cell to reach sequence; returns false if the other side is gone or past the deadline
+  bool write(const T &t, Timestamp deadline); // to be called after room has been acquired; returns false if ready() does
+  bool read(T &t, Timestamp deadline); // to be called after an item has been acquired; returns false if ready() does
+public:
+  static size_t Bytes(); // size of the region
+  SharedPipe();
+  ~SharedPipe();
+  SharedPipe *create(const char *name, Side side); // name starts with a '/'; returns NULL if the region exists already, or on error
+  SharedPipe *open(const char *name, Side side); // returns NULL if the region does not exist or is not initialized yet, or holds another kind of pipe
+  void close(); // detaches the calling process
+  bool push(const T &t); // waits for room; returns false if the readers are gone
+  bool try_push(const T &t); // returns false if the ring is full
+  bool push_until(const T &t, Timestamp deadline);
+  bool pop(T &t); // waits for an item; returns false if the pipe is empty and the writers are gone
+  bool try_pop(T &t);
+  bool pop_until(T &t, Timestamp deadline);
+  template<class Rep, class Period> bool pop_for(T &t, const std::chrono::duration<Rep, Period> &timeout) { return pop_until(t, Time::Get() + std::chrono::duration_cast<std::chrono::microseconds>(timeout)); }
+  uint32 size() const; // items published and not yet claimed by a reader
+  bool peerGone(); // all the processes attached to the other side have detached or died
 };
 #endif
 }
@@ -88,96 +88,200 @@
 namespace core {
 
 #ifdef PIPE_1
-template<typename T, uint32 _S> Pipe11<T, _S>::Pipe11() : Semaphore(0, 65535) {
+template<typename T, uint32 _S> Pipe11<T, _S>::Pipe11() : LightweightSemaphore(0) {
 
-  head_ = tail_ = -1;
+  head_ = tail_ = 0;
   first_ = last_ = new Block(NULL);
-  spare_ = NULL;
 }
 
 template<typename T, uint32 _S> Pipe11<T, _S>::~Pipe11() {
 
+  _clear();
   delete first_;
-  if (spare_)
-    delete spare_;
 }
 
-template<typename T, uint32 _S> inline void Pipe11<T, _S>::_clear() { // leaves spare_ as is
+template<typename T, uint32 _S> inline void Pipe11<T, _S>::_clear() {
+
+  uint32 count = try_acquire(UINT_MAX); // items already claimed by a reader are left in place
+  while (count-- > 0)
+    _pop();
+}
+
+template<typename T, uint32 _S> inline void Pipe11<T, _S>::_grow() {
+
+  last_ = new Block(last_);
+  tail_ = 0;
+  PIPE_STATS(stats_.blockAllocated())
+}
+
+template<typename T, uint32 _S> inline void Pipe11<T, _S>::_shrink() { // the writer has linked the next block before publishing the items we claimed
 
-  enter();
-  reset();
-  if (first_->next_)
-    delete first_->next_;
-  first_->next_ = NULL;
-  head_ = tail_ = -1;
-  leave();
+  Block *b = first_;
+  first_ = b->next_.load(std::memory_order_acquire);
+  b->next_.store(NULL, std::memory_order_relaxed);
+  delete b;
+  head_ = 0;
 }
 
 template<typename T, uint32 _S> inline T Pipe11<T, _S>::_pop() {
 
-  T t = first_->buffer_[head_];
-  if (++head_ == _S) {
+  if (head_ == _S)
+    _shrink();
+  T *s = first_->slot(head_++);
+  T t(std::move(*s));
+  s->~T();
+  PIPE_STATS(stats_.popped(1))
+  return t;
+}
 
-    enter();
-    if (first_ == last_)
-      head_ = tail_ = -1; // stay in the same block; next push will reset head_ and tail_ to 0
-    else {
+template<typename T, uint32 _S> inline void Pipe11<T, _S>::_pop(T *out, uint32 n) {
 
-      if (!spare_) {
+  PIPE_STATS(stats_.popped(n))
+  while (n) {
 
-        spare_ = first_;
-        first_ = first_->next_;
-        spare_->next_ = NULL;
-      } else {
+    if (head_ == _S)
+      _shrink();
+    uint32 run = _S - head_;
+    if (run > n)
+      run = n;
+    T *in = first_->slot(head_);
+    for (uint32 i = 0; i < run; ++i) {
 
-        Block *b = first_->next_;
-        first_->next_ = NULL;
-        delete first_;
-        first_ = b;
-      }
-      head_ = 0;
+      *out++ = std::move(in[i]);
+      in[i].~T();
     }
-    leave();
+    head_ += run;
+    n -= run;
   }
-  return t;
+}
+
+template<typename T, uint32 _S> inline void Pipe11<T, _S>::_peek(PipeSlot<T> &slot) {
+
+  if (head_ == _S)
+    _shrink();
+  slot.item_ = first_->slot(head_);
 }
 
 template<typename T, uint32 _S> inline void Pipe11<T, _S>::push(T &t) {
 
-  enter();
-  if (++tail_ == 0)
-    head_ = 0;
-  uint32 index = tail_;
-  if (tail_ == _S) {
+  emplace(t);
+}
 
-    if (spare_) {
+template<typename T, uint32 _S> inline void Pipe11<T, _S>::push(T &&t) {
 
-      last_->next_ = spare_;
-      last_ = spare_;
-      last_->next_ = NULL;
-      spare_ = NULL;
-    } else
-      last_ = new Block(last_);
-    tail_ = 0;
-    index = tail_;
-  }
-  leave();
+  emplace(std::move(t));
+}
+
+template<typename T, uint32 _S> template<typename... Args> inline void Pipe11<T, _S>::emplace(Args &&... args) {
 
-  last_->buffer_[index] = t;
+  if (tail_ == _S)
+    _grow();
+  new (last_->slot(tail_)) T(std::forward<Args>(args)...);
+  ++tail_;
   release();
+  PIPE_STATS(stats_.pushed(1))
+}
+
+template<typename T, uint32 _S> inline void Pipe11<T, _S>::push(const T *items, uint32 n) {
+
+  for (uint32 left = n; left;) {
+
+    if (tail_ == _S)
+      _grow();
+    uint32 run = _S - tail_;
+    if (run > left)
+      run = left;
+    T *out = last_->slot(tail_);
+    for (uint32 i = 0; i < run; ++i)
+      new (out + i) T(*items++);
+    tail_ += run;
+    left -= run;
+  }
+  if (n) {
+
+    release(n);
+    PIPE_STATS(stats_.pushed(n))
+  }
 }
 
 template<typename T, uint32 _S> inline T Pipe11<T, _S>::pop() {
 
-  Semaphore::acquire();
+  PIPE_STATS(uint64 start = stats_.waitStart())
+  acquire();
+  PIPE_STATS(stats_.waited(start))
   return _pop();
 }
 
+template<typename T, uint32 _S> inline uint32 Pipe11<T, _S>::pop(T *out, uint32 max, uint32 timeout) {
+
+  PIPE_STATS(uint64 start = timeout ? stats_.waitStart() : 0)
+  uint32 n = acquire(max, timeout);
+  PIPE_STATS(stats_.waited(start))
+  _pop(out, n);
+  return n;
+}
+
+template<typename T, uint32 _S> inline bool Pipe11<T, _S>::try_pop(T &t) {
+
+  return pop(&t, 1, 0) == 1;
+}
+
+template<typename T, uint32 _S> inline bool Pipe11<T, _S>::pop_until(T &t, Timestamp deadline) {
+
+  return pop(&t, 1, LightweightSemaphore::TimeoutUntil(deadline)) == 1;
+}
+
+template<typename T, uint32 _S> inline PipeSlot<T> Pipe11<T, _S>::reserve() {
+
+  if (tail_ == _S)
+    _grow();
+  PipeSlot<T> slot;
+  slot.item_ = last_->slot(tail_);
+  return slot;
+}
+
+template<typename T, uint32 _S> inline void Pipe11<T, _S>::commit(PipeSlot<T> &) {
+
+  ++tail_;
+  release();
+  PIPE_STATS(stats_.pushed(1))
+}
+
+template<typename T, uint32 _S> inline PipeSlot<T> Pipe11<T, _S>::peek() {
+
+  PIPE_STATS(uint64 start = stats_.waitStart())
+  acquire();
+  PIPE_STATS(stats_.waited(start))
+  PipeSlot<T> slot;
+  _peek(slot);
+  return slot;
+}
+
+template<typename T, uint32 _S> inline bool Pipe11<T, _S>::try_peek(PipeSlot<T> &slot) {
+
+  if (!try_acquire())
+    return false;
+  _peek(slot);
+  return true;
+}
+
+template<typename T, uint32 _S> inline void Pipe11<T, _S>::release(PipeSlot<T> &slot) {
+
+  slot.item_->~T();
+  ++head_;
+  PIPE_STATS(stats_.popped(1))
+}
+
 template<typename T, uint32 _S> inline void Pipe11<T, _S>::clear() {
 
   _clear();
 }
 
+template<typename T, uint32 _S> inline uint32 Pipe11<T, _S>::BlockBytes() {
+
+  return sizeof(Block);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 template<typename T, uint32 _S> Pipe1N<T, _S>::Pipe1N() {
@@ -195,13 +299,65 @@ template<typename T, uint32 _S> void Pipe1N<T, _S>::clear() {
 
 template<typename T, uint32 _S> T Pipe1N<T, _S>::pop() {
 
-  Semaphore::acquire();
+  PIPE_STATS(uint64 start = this->stats_.waitStart())
+  LightweightSemaphore::acquire();
+  PIPE_STATS(this->stats_.waited(start))
   popCS_.enter();
   T t = Pipe11<T, _S>::_pop();
   popCS_.leave();
   return t;
 }
 
+template<typename T, uint32 _S> uint32 Pipe1N<T, _S>::pop(T *out, uint32 max, uint32 timeout) {
+
+  PIPE_STATS(uint64 start = timeout ? this->stats_.waitStart() : 0)
+  uint32 n = LightweightSemaphore::acquire(max, timeout);
+  PIPE_STATS(this->stats_.waited(start))
+  if (n) {
+
+    popCS_.enter();
+    Pipe11<T, _S>::_pop(out, n);
+    popCS_.leave();
+  }
+  return n;
+}
+
+template<typename T, uint32 _S> bool Pipe1N<T, _S>::try_pop(T &t) {
+
+  return pop(&t, 1, 0) == 1;
+}
+
+template<typename T, uint32 _S> bool Pipe1N<T, _S>::pop_until(T &t, Timestamp deadline) {
+
+  return pop(&t, 1, LightweightSemaphore::TimeoutUntil(deadline)) == 1;
+}
+
+template<typename T, uint32 _S> PipeSlot<T> Pipe1N<T, _S>::peek() {
+
+  PIPE_STATS(uint64 start = this->stats_.waitStart())
+  LightweightSemaphore::acquire();
+  PIPE_STATS(this->stats_.waited(start))
+  popCS_.enter();
+  PipeSlot<T> slot;
+  Pipe11<T, _S>::_peek(slot);
+  return slot;
+}
+
+template<typename T, uint32 _S> bool Pipe1N<T, _S>::try_peek(PipeSlot<T> &slot) {
+
+  if (!LightweightSemaphore::try_acquire())
+    return false;
+  popCS_.enter();
+  Pipe11<T, _S>::_peek(slot);
+  return true;
+}
+
+template<typename T, uint32 _S> void Pipe1N<T, _S>::release(PipeSlot<T> &slot) {
+
+  Pipe11<T, _S>::release(slot);
+  popCS_.leave();
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 template<typename T, uint32 _S> PipeN1<T, _S>::PipeN1() {
@@ -212,18 +368,59 @@ template<typename T, uint32 _S> PipeN1<T, _S>::~PipeN1() {
 
 template<typename T, uint32 _S> void PipeN1<T, _S>::clear() {
 
-  pushCS_.enter();
   Pipe11<T, _S>::_clear();
-  pushCS_.leave();
 }
 
 template<typename T, uint32 _S> void PipeN1<T, _S>::push(T &t) {
 
+  PIPE_STATS(uint64 start = PipeStats::Now())
   pushCS_.enter();
+  PIPE_STATS(this->stats_.locked(start))
   Pipe11<T, _S>::push(t);
   pushCS_.leave();
 }
 
+template<typename T, uint32 _S> void PipeN1<T, _S>::push(T &&t) {
+
+  PIPE_STATS(uint64 start = PipeStats::Now())
+  pushCS_.enter();
+  PIPE_STATS(this->stats_.locked(start))
+  Pipe11<T, _S>::push(std::move(t));
+  pushCS_.leave();
+}
+
+template<typename T, uint32 _S> template<typename... Args> void PipeN1<T, _S>::emplace(Args &&... args) {
+
+  PIPE_STATS(uint64 start = PipeStats::Now())
+  pushCS_.enter();
+  PIPE_STATS(this->stats_.locked(start))
+  Pipe11<T, _S>::emplace(std::forward<Args>(args)...);
+  pushCS_.leave();
+}
+
+template<typename T, uint32 _S> void PipeN1<T, _S>::push(const T *items, uint32 n) {
+
+  PIPE_STATS(uint64 start = PipeStats::Now())
+  pushCS_.enter();
+  PIPE_STATS(this->stats_.locked(start))
+  Pipe11<T, _S>::push(items, n);
+  pushCS_.leave();
+}
+
+template<typename T, uint32 _S> PipeSlot<T> PipeN1<T, _S>::reserve() {
+
+  PIPE_STATS(uint64 start = PipeStats::Now())
+  pushCS_.enter();
+  PIPE_STATS(this->stats_.locked(start))
+  return Pipe11<T, _S>::reserve();
+}
+
+template<typename T, uint32 _S> void PipeN1<T, _S>::commit(PipeSlot<T> &slot) {
+
+  Pipe11<T, _S>::commit(slot);
+  pushCS_.leave();
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 template<typename T, uint32 _S> PipeNN<T, _S>::PipeNN() {
@@ -234,232 +431,2069 @@ template<typename T, uint32 _S> PipeNN<T, _S>::~PipeNN() {
 
 template<typename T, uint32 _S> void PipeNN<T, _S>::clear() {
 
-  pushCS_.enter();
   popCS_.enter();
   Pipe11<T, _S>::_clear();
   popCS_.leave();
-  pushCS_.leave();
 }
 
 template<typename T, uint32 _S> void PipeNN<T, _S>::push(T &t) {
 
+  PIPE_STATS(uint64 start = PipeStats::Now())
   pushCS_.enter();
+  PIPE_STATS(this->stats_.locked(start))
   Pipe11<T, _S>::push(t);
   pushCS_.leave();
 }
 
+template<typename T, uint32 _S> void PipeNN<T, _S>::push(T &&t) {
+
+  PIPE_STATS(uint64 start = PipeStats::Now())
+  pushCS_.enter();
+  PIPE_STATS(this->stats_.locked(start))
+  Pipe11<T, _S>::push(std::move(t));
+  pushCS_.leave();
+}
+
+template<typename T, uint32 _S> template<typename... Args> void PipeNN<T, _S>::emplace(Args &&... args) {
+
+  PIPE_STATS(uint64 start = PipeStats::Now())
+  pushCS_.enter();
+  PIPE_STATS(this->stats_.locked(start))
+  Pipe11<T, _S>::emplace(std::forward<Args>(args)...);
+  pushCS_.leave();
+}
+
+template<typename T, uint32 _S> void PipeNN<T, _S>::push(const T *items, uint32 n) {
+
+  PIPE_STATS(uint64 start = PipeStats::Now())
+  pushCS_.enter();
+  PIPE_STATS(this->stats_.locked(start))
+  Pipe11<T, _S>::push(items, n);
+  pushCS_.leave();
+}
+
 template<typename T, uint32 _S> T PipeNN<T, _S>::pop(bool waitForItem) {
 
-  if (waitForItem)
-    Semaphore::acquire();
-  else {
-    // Use 0 timeout.
-    if (Semaphore::acquire(0))
-      // A timeout means there are no items.
-      return NULL;
-  }
+  if (waitForItem) {
+
+    PIPE_STATS(uint64 start = this->stats_.waitStart())
+    LightweightSemaphore::acquire();
+    PIPE_STATS(this->stats_.waited(start))
+  } else if (!LightweightSemaphore::try_acquire())
+    return T(); // NULL for pointers
   popCS_.enter();
   T t = Pipe11<T, _S>::_pop();
   popCS_.leave();
   return t;
 }
+
+template<typename T, uint32 _S> uint32 PipeNN<T, _S>::pop(T *out, uint32 max, uint32 timeout) {
+
+  PIPE_STATS(uint64 start = timeout ? this->stats_.waitStart() : 0)
+  uint32 n = LightweightSemaphore::acquire(max, timeout);
+  PIPE_STATS(this->stats_.waited(start))
+  if (n) {
+
+    popCS_.enter();
+    Pipe11<T, _S>::_pop(out, n);
+    popCS_.leave();
+  }
+  return n;
+}
+
+template<typename T, uint32 _S> bool PipeNN<T, _S>::try_pop(T &t) {
+
+  return pop(&t, 1, 0) == 1;
+}
+
+template<typename T, uint32 _S> bool PipeNN<T, _S>::pop_until(T &t, Timestamp deadline) {
+
+  return pop(&t, 1, LightweightSemaphore::TimeoutUntil(deadline)) == 1;
+}
+
+template<typename T, uint32 _S> PipeSlot<T> PipeNN<T, _S>::reserve() {
+
+  PIPE_STATS(uint64 start = PipeStats::Now())
+  pushCS_.enter();
+  PIPE_STATS(this->stats_.locked(start))
+  return Pipe11<T, _S>::reserve();
+}
+
+template<typename T, uint32 _S> void PipeNN<T, _S>::commit(PipeSlot<T> &slot) {
+
+  Pipe11<T, _S>::commit(slot);
+  pushCS_.leave();
+}
+
+template<typename T, uint32 _S> PipeSlot<T> PipeNN<T, _S>::peek() {
+
+  PIPE_STATS(uint64 start = this->stats_.waitStart())
+  LightweightSemaphore::acquire();
+  PIPE_STATS(this->stats_.waited(start))
+  popCS_.enter();
+  PipeSlot<T> slot;
+  Pipe11<T, _S>::_peek(slot);
+  return slot;
+}
+
+template<typename T, uint32 _S> bool PipeNN<T, _S>::try_peek(PipeSlot<T> &slot) {
+
+  if (!LightweightSemaphore::try_acquire())
+    return false;
+  popCS_.enter();
+  Pipe11<T, _S>::_peek(slot);
+  return true;
+}
+
+template<typename T, uint32 _S> void PipeNN<T, _S>::release(PipeSlot<T> &slot) {
+
+  Pipe11<T, _S>::release(slot);
+  popCS_.leave();
+}
 #elif defined PIPE_2
-template<typename T, uint32 _S, typename Head, typename Tail, class P, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> Pipe<T, _S, Head, Tail, P, Push, Pop>::Pipe() : Semaphore(0, 1) {
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> Pipe<T, _S, Head, Tail, Push, Pop>::Block::Block(uint64 base) : base_(base), done_(0), next_(NULL) {
 
-  head_ = -1;
-  tail_ = 0;
+  for (uint32 i = 0; i < sizeof(ready_) / sizeof(ready_[0]); ++i)
+    ready_[i].store(0, std::memory_order_relaxed);
+}
 
-  waitingList_ = 0;
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  first_ = last_ = new Block(NULL);
-  spare_ = new Block(NULL);
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> Pipe<T, _S, Head, Tail, Push, Pop>::Pipe() : LightweightSemaphore(0), head_(0), tail_(0), free_(NULL), freeCount_(0), walkers_(0), push_(*this), pop_(*this) {
 
-  _push = new Push<T, _S, P>(*(P *)this);
-  _pop = new Pop<T, _S, P>(*(P *)this);
+  Block *b = new Block(0);
+  first_.store(b, std::memory_order_relaxed);
+  last_.store(b, std::memory_order_relaxed);
 }
 
-template<typename T, uint32 _S, typename Head, typename Tail, class P, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> Pipe<T, _S, Head, Tail, P, Push, Pop>::~Pipe() {
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> Pipe<T, _S, Head, Tail, Push, Pop>::~Pipe() {
 
-  delete first_;
-  if (spare_)
-    delete spare_;
-  delete _push;
-  delete _pop;
+  clear(); // destroys the items left
+  Block *b = first_.load();
+  while (b) {
+
+    Block *next = b->next_.load(std::memory_order_relaxed);
+    delete b;
+    b = next;
+  }
+  while (free_) {
+
+    b = free_->next_.load(std::memory_order_relaxed);
+    delete free_;
+    free_ = b;
+  }
 }
 
-template<typename T, uint32 _S, typename Head, typename Tail, class P, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline void Pipe<T, _S, Head, Tail, P, Push, Pop>::shrink() {
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> typename Pipe<T, _S, Head, Tail, Push, Pop>::Block *Pipe<T, _S, Head, Tail, Push, Pop>::grow(Block *last, uint64 base) {
 
-  if (!spare_) {
+  PIPE_STATS(uint64 start = PipeStats::Now())
+  blockCS_.enter();
+  PIPE_STATS(stats_.locked(start))
+  Block *b = free_;
+  if (b) {
 
-    spare_ = first_;
-    first_ = first_->next_;
-    spare_->next_ = NULL;
+    free_ = b->next_.load(std::memory_order_relaxed);
+    --freeCount_;
+  }
+  blockCS_.leave();
+
+  if (b) {
+
+    b->next_.store(NULL, std::memory_order_relaxed);
+    b->done_.store(0, std::memory_order_relaxed);
+    b->base_.store(base, std::memory_order_relaxed);
   } else {
 
-    Block *b = first_->next_;
-    first_->next_ = NULL;
-    delete first_;
-    first_ = b;
+    b = new Block(base);
+    PIPE_STATS(stats_.blockAllocated())
   }
-  head_ = -1;
+
+  last->next_.store(b); // publishes the new base_
+  last_.store(b, std::memory_order_release);
+  shrink(); // the readers may have completed last before it had a successor; last may be retired from now on
+  return b;
 }
 
-template<typename T, uint32 _S, typename Head, typename Tail, class P, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline void Pipe<T, _S, Head, Tail, P, Push, Pop>::grow() {
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> void Pipe<T, _S, Head, Tail, Push, Pop>::shrink() {
 
-  if (spare_) {
+  Block *surplus = NULL;
+  blockCS_.enter();
+  for (;;) {
 
-    last_->next_ = spare_;
-    last_ = spare_;
-    last_->next_ = NULL;
-    spare_ = NULL;
-  } else
-    last_ = new Block(last_);
-  tail_ = 0;
+    Block *b = first_.load(std::memory_order_relaxed);
+    Block *next = b->next_.load();
+    if (!next || b->done_.load() != _S)
+      break;
+    first_.store(next); // seq_cst: walkers starting from now on do not reach b
+    b->next_.store(free_, std::memory_order_relaxed);
+    free_ = b;
+    ++freeCount_;
+  }
+  if (freeCount_ > FreeReserve && walkers_.load() == 0) { // the walkers that could reach a retired block have left
+
+    while (freeCount_ > FreeReserve) {
+
+      Block *b = free_;
+      free_ = b->next_.load(std::memory_order_relaxed);
+      b->next_.store(surplus, std::memory_order_relaxed);
+      surplus = b;
+      --freeCount_;
+    }
+  }
+  blockCS_.leave();
+  while (surplus) {
+
+    Block *next = surplus->next_.load(std::memory_order_relaxed);
+    delete surplus;
+    surplus = next;
+  }
+}
+
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline typename Pipe<T, _S, Head, Tail, Push, Pop>::Block *Pipe<T, _S, Head, Tail, Push, Pop>::locate(uint64 ticket) {
+
+  walkers_.fetch_add(1);
+  Block *b = first_.load(); // seq_cst: or shrink() sees us
+  while (b) {
+
+    uint64 base = b->base_.load(std::memory_order_acquire);
+    if (ticket < base) // b has been recycled meanwhile
+      break;
+    if (ticket < base + _S) {
+
+      walkers_.fetch_sub(1, std::memory_order_release);
+      return b; // b cannot be retired before ticket is read
+    }
+    b = b->next_.load(std::memory_order_acquire);
+  }
+  walkers_.fetch_sub(1, std::memory_order_release);
+  return NULL;
 }
 
-template<typename T, uint32 _S, typename Head, typename Tail, class P, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline void Pipe<T, _S, Head, Tail, P, Push, Pop>::push(T &t) {
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> typename Pipe<T, _S, Head, Tail, Push, Pop>::Block *Pipe<T, _S, Head, Tail, Push, Pop>::locateTail(uint64 ticket) {
+
+  Block *b;
+  walkers_.fetch_add(1); // last_ may lag behind a block being retired
+  for (;;) {
+
+    b = last_.load(); // seq_cst: or shrink() sees us
+    uint64 base = b->base_.load(std::memory_order_acquire);
+    if (ticket >= base) {
 
-  (*_push)(t);
+      if (ticket < base + _S)
+        break;
+      if (ticket == base + _S) { // first ticket past the last block: b cannot have a successor yet
+
+        b = grow(b, ticket);
+        break;
+      }
+      std::this_thread::yield(); // another writer is appending the block before ours
+    } else if ((b = locate(ticket)) != NULL) // our block is not the last one anymore
+      break;
+  }
+  walkers_.fetch_sub(1, std::memory_order_release);
+  return b;
 }
 
-template<typename T, uint32 _S, typename Head, typename Tail, class P, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline T Pipe<T, _S, Head, Tail, P, Push, Pop>::pop() {
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline T *Pipe<T, _S, Head, Tail, Push, Pop>::readable(Block *b, uint32 index) {
+
+  if (!Push<T, _S, Pipe>::Ordered) {
 
-  return (*_pop)();
+    while (!b->ready_[index].load(std::memory_order_acquire)) // the writer is still copying the item
+      std::this_thread::yield();
+    b->ready_[index].store(0, std::memory_order_relaxed);
+  }
+  return b->slot(index);
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline void Pipe<T, _S, Head, Tail, Push, Pop>::done(Block *b, uint32 n) {
 
-template<class Pipe> PipeFunctor<Pipe>::PipeFunctor(Pipe &p) : pipe(p) {
+  PIPE_STATS(stats_.popped(n))
+  if (b->done_.fetch_add(n) + n == _S)
+    shrink();
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline T Pipe<T, _S, Head, Tail, Push, Pop>::read(Block *b, uint32 index) {
 
-template<typename T, uint32 _S, class Pipe> Push1<T, _S, Pipe>::Push1(Pipe &p) : PipeFunctor<Pipe>(p) {
+  T *s = readable(b, index);
+  T t(std::move(*s));
+  s->~T();
+  done(b, 1);
+  return t;
 }
 
-template<typename T, uint32 _S, class Pipe> void Push1<T, _S, Pipe>::operator ()(T &t) {
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline void Pipe<T, _S, Head, Tail, Push, Pop>::read(Block *b, uint32 index, T *out, uint32 n) {
+
+  for (uint32 i = index; i < index + n; ++i) {
 
-  pipe.last_->buffer_[pipe.tail_] = t;
+    T *s = readable(b, i);
+    *out++ = std::move(*s);
+    s->~T();
+  }
+  done(b, n);
+}
 
-  if (++pipe.tail_ == (int32)_S)
-    pipe.grow();
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> void Pipe<T, _S, Head, Tail, Push, Pop>::clear() {
 
-  int32 count = Atomic::Decrement32(&pipe.waitingList_);
-  if (count >= 0) // at least one reader is waiting
-    pipe.release(); // unlock one reader
+  uint32 count = try_acquire(UINT_MAX); // items already claimed by a reader are left in place
+  while (count-- > 0)
+    pop_();
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline void Pipe<T, _S, Head, Tail, Push, Pop>::push(T &t) {
 
-template<typename T, uint32 _S, class Pipe> PushN<T, _S, Pipe>::PushN(Pipe &p) : PipeFunctor<Pipe>(p), Semaphore(0, 1) {
+  push_.emplace(t);
+  PIPE_STATS(stats_.pushed(1))
 }
 
-template<typename T, uint32 _S, class Pipe> void PushN<T, _S, Pipe>::operator ()(T &t) {
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline void Pipe<T, _S, Head, Tail, Push, Pop>::push(T &&t) {
 
-check_tail: int32 tail = Atomic::Increment32(&pipe.tail_) - 1;
+  push_.emplace(std::move(t));
+  PIPE_STATS(stats_.pushed(1))
+}
 
-  if (tail < (int32)_S)
-    pipe.last_->buffer_[tail] = t;
-  else if (tail == (int32)_S) {
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> template<typename... Args> inline void Pipe<T, _S, Head, Tail, Push, Pop>::emplace(Args &&... args) {
 
-    pipe.grow(); // tail set to 0
+  push_.emplace(std::forward<Args>(args)...);
+  PIPE_STATS(stats_.pushed(1))
+}
 
-    pipe.last_->buffer_[pipe.tail_++] = t;
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline void Pipe<T, _S, Head, Tail, Push, Pop>::push(const T *items, uint32 n) {
 
-    release(); // unlock writers
-    acquire(); // make sure the sem falls back to 0
-  } else { // tail>_S: pipe.last_ and pipe.tail_ are being changed
+  if (n) {
 
-    acquire(); // wait
-    release(); // unlock other writers
-    goto check_tail;
+    push_(items, n);
+    PIPE_STATS(stats_.pushed(n))
   }
+}
 
-  int32 count = Atomic::Decrement32(&pipe.waitingList_);
-  if (count >= 0) // at least one reader is waiting
-    pipe.release(); // unlock one reader
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline T Pipe<T, _S, Head, Tail, Push, Pop>::pop() {
+
+  PIPE_STATS(uint64 start = stats_.waitStart())
+  acquire();
+  PIPE_STATS(stats_.waited(start))
+  return pop_();
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline uint32 Pipe<T, _S, Head, Tail, Push, Pop>::pop(T *out, uint32 max, uint32 timeout) {
+
+  PIPE_STATS(uint64 start = timeout ? stats_.waitStart() : 0)
+  uint32 n = acquire(max, timeout);
+  PIPE_STATS(stats_.waited(start))
+  if (n)
+    pop_(out, n);
+  return n;
+}
 
-template<typename T, uint32 _S, class Pipe> Pop1<T, _S, Pipe>::Pop1(Pipe &p) : PipeFunctor<Pipe>(p) {
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline bool Pipe<T, _S, Head, Tail, Push, Pop>::try_pop(T &t) {
+
+  return pop(&t, 1, 0) == 1;
 }
 
-template<typename T, uint32 _S, class Pipe> T Pop1<T, _S, Pipe>::operator ()() {
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline bool Pipe<T, _S, Head, Tail, Push, Pop>::pop_until(T &t, Timestamp deadline) {
 
-  int32 count = Atomic::Increment32(&pipe.waitingList_);
-  if (count > 0) // no free lunch
-    pipe.acquire(); // wait for a push
+  return pop(&t, 1, LightweightSemaphore::TimeoutUntil(deadline)) == 1;
+}
 
-  if (pipe.head_ == (int32)_S - 1)
-    pipe.shrink();
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline PipeSlot<T> Pipe<T, _S, Head, Tail, Push, Pop>::reserve() {
 
-  T t = pipe.first_->buffer_[++pipe.head_];
+  PipeSlot<T> slot;
+  push_.reserve(slot);
+  return slot;
+}
 
-  return t;
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline void Pipe<T, _S, Head, Tail, Push, Pop>::commit(PipeSlot<T> &slot) {
+
+  push_.commit(slot);
+  PIPE_STATS(stats_.pushed(1))
+}
+
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline PipeSlot<T> Pipe<T, _S, Head, Tail, Push, Pop>::peek() {
+
+  PIPE_STATS(uint64 start = stats_.waitStart())
+  acquire();
+  PIPE_STATS(stats_.waited(start))
+  PipeSlot<T> slot;
+  pop_.peek(slot);
+  return slot;
+}
+
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline bool Pipe<T, _S, Head, Tail, Push, Pop>::try_peek(PipeSlot<T> &slot) {
+
+  if (!try_acquire())
+    return false;
+  pop_.peek(slot);
+  return true;
+}
+
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline void Pipe<T, _S, Head, Tail, Push, Pop>::release(PipeSlot<T> &slot) {
+
+  slot.item_->~T();
+  done((Block *)slot.block_, 1);
+}
+
+template<typename T, uint32 _S, typename Head, typename Tail, template<typename, uint32, class> class Push, template<typename, uint32, class> class Pop> inline uint32 Pipe<T, _S, Head, Tail, Push, Pop>::BlockBytes() {
+
+  return sizeof(Block);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-template<typename T, uint32 _S, class Pipe> PopN<T, _S, Pipe>::PopN(Pipe &p) : PipeFunctor<Pipe>(p), Semaphore(0, 1) {
+template<class Pipe> PipeFunctor<Pipe>::PipeFunctor(Pipe &p) : pipe_(p) {
 }
 
-template<typename T, uint32 _S, class Pipe> T PopN<T, _S, Pipe>::operator ()() {
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T, uint32 _S, class Pipe> Push1<T, _S, Pipe>::Push1(Pipe &p) : PipeFunctor<Pipe>(p) {
+}
 
-  int32 count = Atomic::Increment32(&pipe.waitingList_);
-  if (count > 0) // no free lunch
-    pipe.acquire(); // wait for a push
+template<typename T, uint32 _S, class Pipe> template<typename... Args> inline void Push1<T, _S, Pipe>::emplace(Args &&... args) {
 
-check_head: int32 head = Atomic::Increment32(&pipe.head_);
-  if (head < (int32)_S)
-    return pipe.first_->buffer_[head];
+  Pipe &pipe = this->pipe_;
+  uint64 ticket = pipe.tail_++;
+  typename Pipe::Block *b = pipe.last_.load(std::memory_order_relaxed); // only this writer changes last_
+  uint32 index = (uint32)(ticket - b->base_.load(std::memory_order_relaxed));
+  if (index == _S) {
 
-  if (head == (int32)_S) {
+    b = pipe.grow(b, ticket);
+    index = 0;
+  }
+  new (b->slot(index)) T(std::forward<Args>(args)...);
+  pipe.release();
+}
 
-    pipe.shrink(); // head set to -1
+template<typename T, uint32 _S, class Pipe> void Push1<T, _S, Pipe>::operator ()(const T *items, uint32 n) {
 
-    release(); // unlock readers
-    acquire(); // make sure the sem falls back to 0
+  Pipe &pipe = this->pipe_;
+  uint64 ticket = pipe.tail_;
+  pipe.tail_ += n;
+  typename Pipe::Block *b = pipe.last_.load(std::memory_order_relaxed);
+  uint32 index = (uint32)(ticket - b->base_.load(std::memory_order_relaxed));
+  for (uint32 left = n; left;) {
 
-    return pipe.first_->buffer_[++pipe.head_];
-  } else { // head>_S: pipe.first_ and pipe.head_ are being changed
+    if (index == _S) {
 
-    acquire(); // wait
-    release(); // unlock other readers
-    goto check_head;
+      b = pipe.grow(b, ticket);
+      index = 0;
+    }
+    uint32 run = _S - index;
+    if (run > left)
+      run = left;
+    for (uint32 i = 0; i < run; ++i)
+      new (b->slot(index++)) T(*items++);
+    ticket += run;
+    left -= run;
   }
+  pipe.release(n);
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template<typename T, uint32 _S, class Pipe> inline void Push1<T, _S, Pipe>::reserve(PipeSlot<T> &slot) {
+
+  Pipe &pipe = this->pipe_;
+  uint64 ticket = pipe.tail_; // taken on commit
+  typename Pipe::Block *b = pipe.last_.load(std::memory_order_relaxed);
+  uint32 index = (uint32)(ticket - b->base_.load(std::memory_order_relaxed));
+  if (index == _S) {
 
-template<typename T, uint32 S> Pipe11<T, S>::Pipe11() : Pipe<T, S, int32, int32, Pipe11<T, S>, Push1, Pop1>() {
+    b = pipe.grow(b, ticket);
+    index = 0;
+  }
+  slot.item_ = b->slot(index);
+  slot.block_ = b;
+  slot.index_ = index;
 }
 
-template<typename T, uint32 S> Pipe11<T, S>::~Pipe11() {
+template<typename T, uint32 _S, class Pipe> inline void Push1<T, _S, Pipe>::commit(PipeSlot<T> &) {
+
+  ++this->pipe_.tail_;
+  this->pipe_.release();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-template<typename T, uint32 S> Pipe1N<T, S>::Pipe1N() : Pipe<T, S, int32, int32 volatile, Pipe1N, Push1, PopN>() {
+template<typename T, uint32 _S, class Pipe> PushN<T, _S, Pipe>::PushN(Pipe &p) : PipeFunctor<Pipe>(p) {
 }
 
-template<typename T, uint32 S> Pipe1N<T, S>::~Pipe1N() {
+template<typename T, uint32 _S, class Pipe> template<typename... Args> inline void PushN<T, _S, Pipe>::emplace(Args &&... args) {
+
+  Pipe &pipe = this->pipe_;
+  uint64 ticket = pipe.tail_.fetch_add(1);
+  typename Pipe::Block *b = pipe.locateTail(ticket);
+  uint32 index = (uint32)(ticket - b->base_.load(std::memory_order_relaxed));
+  new (b->slot(index)) T(std::forward<Args>(args)...);
+  b->ready_[index].store(1, std::memory_order_release);
+  pipe.release();
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template<typename T, uint32 _S, class Pipe> void PushN<T, _S, Pipe>::operator ()(const T *items, uint32 n) {
+
+  Pipe &pipe = this->pipe_;
+  uint64 ticket = pipe.tail_.fetch_add(n);
+  for (uint32 left = n; left;) {
+
+    typename Pipe::Block *b = pipe.locateTail(ticket);
+    uint32 index = (uint32)(ticket - b->base_.load(std::memory_order_relaxed));
+    uint32 run = _S - index;
+    if (run > left)
+      run = left;
+    for (uint32 i = 0; i < run; ++i, ++index) {
+
+      new (b->slot(index)) T(*items++);
+      b->ready_[index].store(1, std::memory_order_release);
+    }
+    ticket += run;
+    left -= run;
+  }
+  pipe.release(n);
+}
 
-template<typename T, uint32 S> PipeN1<T, S>::PipeN1() : Pipe<T, S, int32 volatile, int32, PipeN1, PushN, Pop1>() {
+template<typename T, uint32 _S, class Pipe> inline void PushN<T, _S, Pipe>::reserve(PipeSlot<T> &slot) {
+
+  Pipe &pipe = this->pipe_;
+  uint64 ticket = pipe.tail_.fetch_add(1);
+  typename Pipe::Block *b = pipe.locateTail(ticket);
+  uint32 index = (uint32)(ticket - b->base_.load(std::memory_order_relaxed));
+  slot.item_ = b->slot(index);
+  slot.block_ = b;
+  slot.index_ = index;
 }
 
-template<typename T, uint32 S> PipeN1<T, S>::~PipeN1() {
+template<typename T, uint32 _S, class Pipe> inline void PushN<T, _S, Pipe>::commit(PipeSlot<T> &slot) {
+
+  ((typename Pipe::Block *)slot.block_)->ready_[slot.index_].store(1, std::memory_order_release);
+  this->pipe_.release();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-template<typename T, uint32 S> PipeNN<T, S>::PipeNN() : Pipe<T, S, int32 volatile, int32 volatile, PipeNN, PushN, PopN>() {
+template<typename T, uint32 _S, class Pipe> Pop1<T, _S, Pipe>::Pop1(Pipe &p) : PipeFunctor<Pipe>(p), block_(NULL), base_(0) {
 }
 
-template<typename T, uint32 S> PipeNN<T, S>::~PipeNN() {
+template<typename T, uint32 _S, class Pipe> inline void Pop1<T, _S, Pipe>::locate(uint64 ticket) {
+
+  if (!block_ || ticket >= base_ + _S) { // block_ may have been recycled: start over from the head
+
+    while (!(block_ = this->pipe_.locate(ticket)))
+      std::this_thread::yield();
+    base_ = block_->base_.load(std::memory_order_relaxed);
+  }
+}
+
+template<typename T, uint32 _S, class Pipe> inline T Pop1<T, _S, Pipe>::operator ()() {
+
+  uint64 ticket = this->pipe_.head_++;
+  locate(ticket);
+  return this->pipe_.read(block_, (uint32)(ticket - base_));
+}
+
+template<typename T, uint32 _S, class Pipe> void Pop1<T, _S, Pipe>::operator ()(T *out, uint32 n) {
+
+  uint64 ticket = this->pipe_.head_;
+  this->pipe_.head_ += n;
+  while (n) {
+
+    locate(ticket);
+    uint32 index = (uint32)(ticket - base_);
+    uint32 run = _S - index;
+    if (run > n)
+      run = n;
+    this->pipe_.read(block_, index, out, run);
+    out += run;
+    ticket += run;
+    n -= run;
+  }
+}
+
+template<typename T, uint32 _S, class Pipe> inline void Pop1<T, _S, Pipe>::peek(PipeSlot<T> &slot) {
+
+  uint64 ticket = this->pipe_.head_++;
+  locate(ticket);
+  slot.index_ = (uint32)(ticket - base_);
+  slot.item_ = this->pipe_.readable(block_, slot.index_);
+  slot.block_ = block_;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T, uint32 _S, class Pipe> PopN<T, _S, Pipe>::PopN(Pipe &p) : PipeFunctor<Pipe>(p) {
+}
+
+template<typename T, uint32 _S, class Pipe> inline T PopN<T, _S, Pipe>::operator ()() {
+
+  Pipe &pipe = this->pipe_;
+  uint64 ticket = pipe.head_.fetch_add(1);
+  typename Pipe::Block *b;
+  while (!(b = pipe.locate(ticket))) // the writer of ticket is appending its block
+    std::this_thread::yield();
+  return pipe.read(b, (uint32)(ticket - b->base_.load(std::memory_order_relaxed)));
+}
+
+template<typename T, uint32 _S, class Pipe> void PopN<T, _S, Pipe>::operator ()(T *out, uint32 n) {
+
+  Pipe &pipe = this->pipe_;
+  uint64 ticket = pipe.head_.fetch_add(n);
+  while (n) {
+
+    typename Pipe::Block *b;
+    while (!(b = pipe.locate(ticket)))
+      std::this_thread::yield();
+    uint32 index = (uint32)(ticket - b->base_.load(std::memory_order_relaxed));
+    uint32 run = _S - index;
+    if (run > n)
+      run = n;
+    pipe.read(b, index, out, run);
+    out += run;
+    ticket += run;
+    n -= run;
+  }
+}
+
+template<typename T, uint32 _S, class Pipe> inline void PopN<T, _S, Pipe>::peek(PipeSlot<T> &slot) {
+
+  Pipe &pipe = this->pipe_;
+  uint64 ticket = pipe.head_.fetch_add(1);
+  typename Pipe::Block *b;
+  while (!(b = pipe.locate(ticket)))
+    std::this_thread::yield();
+  slot.index_ = (uint32)(ticket - b->base_.load(std::memory_order_relaxed));
+  slot.item_ = pipe.readable(b, slot.index_);
+  slot.block_ = b;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T, uint32 S> Pipe11<T, S>::Pipe11() : Pipe<T, S, uint64, uint64, Push1, Pop1>() {
+}
+
+template<typename T, uint32 S> Pipe11<T, S>::~Pipe11() {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T, uint32 S> Pipe1N<T, S>::Pipe1N() : Pipe<T, S, std::atomic<uint64>, uint64, Push1, PopN>() {
+}
+
+template<typename T, uint32 S> Pipe1N<T, S>::~Pipe1N() {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T, uint32 S> PipeN1<T, S>::PipeN1() : Pipe<T, S, uint64, std::atomic<uint64>, PushN, Pop1>() {
+}
+
+template<typename T, uint32 S> PipeN1<T, S>::~PipeN1() {
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T, uint32 S> PipeNN<T, S>::PipeNN() : Pipe<T, S, std::atomic<uint64>, std::atomic<uint64>, PushN, PopN>() {
+}
+
+template<typename T, uint32 S> PipeNN<T, S>::~PipeNN() {
+}
+
+template<typename T, uint32 S> T PipeNN<T, S>::pop(bool waitForItem) {
+
+  if (waitForItem) {
+
+    PIPE_STATS(uint64 start = this->stats_.waitStart())
+    this->acquire();
+    PIPE_STATS(this->stats_.waited(start))
+  } else if (!this->try_acquire())
+    return T(); // NULL for pointers
+  return this->pop_();
+}
+
+template<typename T, uint32 S> uint32 PipeNN<T, S>::pop(T *out, uint32 max, uint32 timeout) {
+
+  return Pipe<T, S, std::atomic<uint64>, std::atomic<uint64>, PushN, PopN>::pop(out, max, timeout);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline uint32 BoundedPipe<T, _S, P>::High(uint32 capacity, uint32 highWatermark) {
+
+  return highWatermark && highWatermark < capacity ? highWatermark : capacity;
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline uint32 BoundedPipe<T, _S, P>::Low(uint32 capacity, uint32 highWatermark, uint32 lowWatermark) {
+
+  uint32 high = High(capacity, highWatermark);
+  uint32 below = high ? high - 1 : 0; // highest low watermark: reached only once high has been left
+  if (!lowWatermark)
+    lowWatermark = capacity / 2;
+  return lowWatermark < below ? lowWatermark : below;
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> BoundedPipe<T, _S, P>::BoundedPipe(uint32 capacity, uint32 highWatermark, uint32 lowWatermark) : P<T, _S>(),
+  room_(capacity),
+  size_(0),
+  high_(false),
+  highWatermark_(High(capacity, highWatermark)),
+  lowWatermark_(Low(capacity, highWatermark, lowWatermark)) {
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> BoundedPipe<T, _S, P>::~BoundedPipe() {
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> void BoundedPipe<T, _S, P>::onHighWatermark() {
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> void BoundedPipe<T, _S, P>::onLowWatermark() {
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline void BoundedPipe<T, _S, P>::grown(uint32 n) {
+
+  int32 size = size_.fetch_add(n, std::memory_order_relaxed) + n;
+  if (size >= highWatermark_ && size - (int32)n < highWatermark_ && !high_.exchange(true))
+    onHighWatermark();
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline void BoundedPipe<T, _S, P>::shrunk(uint32 n) {
+
+  int32 size = size_.fetch_sub(n, std::memory_order_relaxed) - n;
+  if (size <= lowWatermark_ && size + (int32)n > lowWatermark_ && high_.exchange(false))
+    onLowWatermark();
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> void BoundedPipe<T, _S, P>::clear() {
+
+  PipeSlot<T> slot;
+  while (P<T, _S>::try_peek(slot)) { // destroys the items in place: T need not be default constructible
+
+    P<T, _S>::release(slot);
+    shrunk(1);
+    room_.release();
+  }
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline void BoundedPipe<T, _S, P>::push(T &t) {
+
+  room_.acquire();
+  P<T, _S>::push(t);
+  grown(1);
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline void BoundedPipe<T, _S, P>::push(T &&t) {
+
+  room_.acquire();
+  P<T, _S>::push(std::move(t));
+  grown(1);
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> template<typename... Args> inline void BoundedPipe<T, _S, P>::emplace(Args &&... args) {
+
+  room_.acquire();
+  P<T, _S>::emplace(std::forward<Args>(args)...);
+  grown(1);
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline bool BoundedPipe<T, _S, P>::push(T &t, uint32 timeout) {
+
+  if (room_.acquire(timeout))
+    return true;
+  P<T, _S>::push(t);
+  grown(1);
+  return false;
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline bool BoundedPipe<T, _S, P>::try_push(T &t) {
+
+  if (!room_.try_acquire())
+    return false;
+  P<T, _S>::push(t);
+  grown(1);
+  return true;
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline uint32 BoundedPipe<T, _S, P>::push(const T *items, uint32 n, uint32 timeout) {
+
+  n = room_.acquire(n, timeout);
+  if (n) {
+
+    P<T, _S>::push(items, n);
+    grown(n);
+  }
+  return n;
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline T BoundedPipe<T, _S, P>::pop() {
+
+  T t = P<T, _S>::pop();
+  shrunk(1);
+  room_.release();
+  return t;
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline uint32 BoundedPipe<T, _S, P>::pop(T *out, uint32 max, uint32 timeout) {
+
+  uint32 n = P<T, _S>::pop(out, max, timeout);
+  if (n) {
+
+    shrunk(n);
+    room_.release(n);
+  }
+  return n;
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline bool BoundedPipe<T, _S, P>::try_pop(T &t) {
+
+  return pop(&t, 1, 0) == 1;
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline bool BoundedPipe<T, _S, P>::pop_until(T &t, Timestamp deadline) {
+
+  return pop(&t, 1, LightweightSemaphore::TimeoutUntil(deadline)) == 1;
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline PipeSlot<T> BoundedPipe<T, _S, P>::reserve() {
+
+  room_.acquire();
+  return P<T, _S>::reserve();
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline void BoundedPipe<T, _S, P>::commit(PipeSlot<T> &slot) {
+
+  P<T, _S>::commit(slot);
+  grown(1);
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline PipeSlot<T> BoundedPipe<T, _S, P>::peek() {
+
+  return P<T, _S>::peek();
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline bool BoundedPipe<T, _S, P>::try_peek(PipeSlot<T> &slot) {
+
+  return P<T, _S>::try_peek(slot);
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline void BoundedPipe<T, _S, P>::release(PipeSlot<T> &slot) {
+
+  P<T, _S>::release(slot);
+  shrunk(1);
+  room_.release();
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline uint32 BoundedPipe<T, _S, P>::size() const {
+
+  int32 size = size_.load(std::memory_order_relaxed);
+  return size > 0 ? size : 0;
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline bool BoundedPipe<T, _S, P>::isHigh() const {
+
+  return high_.load(std::memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T, uint32 _S, uint32 _L, template<typename, uint32> class P> PriorityPipe<T, _S, _L, P>::PriorityPipe(const uint32 *weights) : LightweightSemaphore(0), turn_(0) {
+
+  if (!weights)
+    return;
+  uint32 total = 0;
+  for (uint32 i = 0; i < _L; ++i)
+    total += weights[i];
+  std::vector<uint32> given(_L, 0);
+  for (uint32 turn = 0; turn < total; ++turn) { // interleaves the lanes: each turn goes to the lane furthest behind its share
+
+    uint32 lane = 0;
+    float64 lag = -1;
+    for (uint32 i = 0; i < _L; ++i) {
+
+      float64 l = (float64)weights[i] * (turn + 1) / total - given[i];
+      if (weights[i] && l > lag) {
+
+        lag = l;
+        lane = i;
+      }
+    }
+    ++given[lane];
+    schedule_.push_back(lane);
+  }
+}
+
+template<typename T, uint32 _S, uint32 _L, template<typename, uint32> class P> PriorityPipe<T, _S, _L, P>::~PriorityPipe() {
+}
+
+template<typename T, uint32 _S, uint32 _L, template<typename, uint32> class P> P<T, _S> &PriorityPipe<T, _S, _L, P>::_peek(PipeSlot<T> &slot) { // peeks rather than pops: T need not be default constructible
+
+  if (!schedule_.empty()) {
+
+    uint32 lane = schedule_[turn_.fetch_add(1, std::memory_order_relaxed) % schedule_.size()];
+    if (lanes_[lane].try_peek(slot))
+      return lanes_[lane];
+  }
+  for (;;) // the item we acquired is in some lane, unless another reader took it: then another one is
+    for (uint32 i = 0; i < _L; ++i)
+      if (lanes_[i].try_peek(slot))
+        return lanes_[i];
+}
+
+template<typename T, uint32 _S, uint32 _L, template<typename, uint32> class P> inline void PriorityPipe<T, _S, _L, P>::_pop(T &t) {
+
+  PipeSlot<T> slot;
+  P<T, _S> &lane = _peek(slot);
+  t = std::move(*slot.item_);
+  lane.release(slot);
+}
+
+template<typename T, uint32 _S, uint32 _L, template<typename, uint32> class P> void PriorityPipe<T, _S, _L, P>::clear() {
+
+  uint32 count = try_acquire(UINT_MAX); // items already claimed by a reader are left in place
+  PipeSlot<T> slot;
+  while (count-- > 0)
+    _peek(slot).release(slot);
+}
+
+template<typename T, uint32 _S, uint32 _L, template<typename, uint32> class P> inline void PriorityPipe<T, _S, _L, P>::push(T &t, uint32 lane) {
+
+  lanes_[lane].push(t);
+  release();
+}
+
+template<typename T, uint32 _S, uint32 _L, template<typename, uint32> class P> inline void PriorityPipe<T, _S, _L, P>::push(T &&t, uint32 lane) {
+
+  lanes_[lane].push(std::move(t));
+  release();
+}
+
+template<typename T, uint32 _S, uint32 _L, template<typename, uint32> class P> template<typename... Args> inline void PriorityPipe<T, _S, _L, P>::emplace(uint32 lane, Args &&... args) {
+
+  lanes_[lane].emplace(std::forward<Args>(args)...);
+  release();
+}
+
+template<typename T, uint32 _S, uint32 _L, template<typename, uint32> class P> inline T PriorityPipe<T, _S, _L, P>::pop() {
+
+  acquire();
+  PipeSlot<T> slot;
+  P<T, _S> &lane = _peek(slot);
+  T t(std::move(*slot.item_));
+  lane.release(slot);
+  return t;
+}
+
+template<typename T, uint32 _S, uint32 _L, template<typename, uint32> class P> inline bool PriorityPipe<T, _S, _L, P>::try_pop(T &t) {
+
+  if (!try_acquire())
+    return false;
+  _pop(t);
+  return true;
+}
+
+template<typename T, uint32 _S, uint32 _L, template<typename, uint32> class P> inline bool PriorityPipe<T, _S, _L, P>::pop_until(T &t, Timestamp deadline) {
+
+  uint32 timeout = TimeoutUntil(deadline);
+  if (timeout ? acquire(timeout) : !try_acquire())
+    return false;
+  _pop(t);
+  return true;
+}
+
+template<typename T, uint32 _S, uint32 _L, template<typename, uint32> class P> inline uint32 PriorityPipe<T, _S, _L, P>::size(uint32 lane) const {
+
+  int32 count = lanes_[lane].count();
+  return count > 0 ? count : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T, uint32 _S, uint32 _N> ShardedPipe<T, _S, _N>::Shard::Shard() : first_(new Block()), last_(first_), spare_(NULL), head_(0), tail_(0), count_(0) {
+}
+
+template<typename T, uint32 _S, uint32 _N> ShardedPipe<T, _S, _N>::Shard::~Shard() {
+
+  while (count_.load(std::memory_order_relaxed))
+    pop_front();
+  while (first_) {
+
+    Block *next = first_->next_;
+    delete first_;
+    first_ = next;
+  }
+  delete spare_;
+}
+
+template<typename T, uint32 _S, uint32 _N> template<typename... Args> inline void ShardedPipe<T, _S, _N>::Shard::emplace(Args &&... args) {
+
+  if (tail_ == _S) {
+
+    Block *b = spare_ ? spare_ : new Block();
+    spare_ = NULL;
+    b->next_ = NULL;
+    last_->next_ = b;
+    last_ = b;
+    tail_ = 0;
+  }
+  new (last_->slot(tail_++)) T(std::forward<Args>(args)...);
+  count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+template<typename T, uint32 _S, uint32 _N> inline T *ShardedPipe<T, _S, _N>::Shard::front() {
+
+  if (head_ == _S) { // first_ is done: it has a successor, since the shard is not empty
+
+    Block *b = first_;
+    first_ = b->next_;
+    head_ = 0;
+    delete spare_;
+    spare_ = b;
+  }
+  return first_->slot(head_);
+}
+
+template<typename T, uint32 _S, uint32 _N> inline void ShardedPipe<T, _S, _N>::Shard::pop_front() {
+
+  front()->~T();
+  ++head_;
+  uint32 count = count_.load(std::memory_order_relaxed) - 1;
+  count_.store(count, std::memory_order_relaxed);
+  if (!count && first_ == last_) // rewinds the last block rather than filling it up
+    head_ = tail_ = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T, uint32 _S, uint32 _N> ShardedPipe<T, _S, _N>::ShardedPipe() : LightweightSemaphore(0), next_(0) {
+
+  shards_ = (Shard *)Memory::AlignedAllocate(_N * sizeof(Shard));
+  for (uint32 i = 0; i < _N; ++i)
+    new (shards_ + i) Shard();
+}
+
+template<typename T, uint32 _S, uint32 _N> ShardedPipe<T, _S, _N>::~ShardedPipe() {
+
+  for (uint32 i = 0; i < _N; ++i)
+    shards_[i].~Shard();
+  Memory::AlignedFree(shards_);
+}
+
+template<typename T, uint32 _S, uint32 _N> inline typename ShardedPipe<T, _S, _N>::Shard &ShardedPipe<T, _S, _N>::shard() {
+
+  return shards_[Thread::Index() % _N];
+}
+
+template<typename T, uint32 _S, uint32 _N> typename ShardedPipe<T, _S, _N>::Shard &ShardedPipe<T, _S, _N>::take() {
+
+  for (;;) { // the item we acquired is in some shard, unless another reader took it: then another one is
+
+    uint32 start = next_.load(std::memory_order_relaxed);
+    for (uint32 i = 0; i < _N; ++i) {
+
+      uint32 index = (start + i) % _N;
+      Shard &s = shards_[index];
+      if (!s.count_.load(std::memory_order_relaxed))
+        continue;
+      s.cs_.enter();
+      if (s.count_.load(std::memory_order_relaxed)) {
+
+        next_.store(index + 1, std::memory_order_relaxed); // a plain store: readers racing on it only skew the rotation
+        return s;
+      }
+      s.cs_.leave();
+    }
+  }
+}
+
+template<typename T, uint32 _S, uint32 _N> inline void ShardedPipe<T, _S, _N>::_pop(T &t) {
+
+  Shard &s = take();
+  t = std::move(*s.front());
+  s.pop_front();
+  s.cs_.leave();
+}
+
+template<typename T, uint32 _S, uint32 _N> void ShardedPipe<T, _S, _N>::_pop(T *out, uint32 n) {
+
+  while (n) {
+
+    Shard &s = take();
+    for (; n && s.count_.load(std::memory_order_relaxed); --n) {
+
+      *out++ = std::move(*s.front());
+      s.pop_front();
+    }
+    s.cs_.leave();
+  }
+}
+
+template<typename T, uint32 _S, uint32 _N> void ShardedPipe<T, _S, _N>::clear() {
+
+  uint32 count = try_acquire(UINT_MAX); // items already claimed by a reader are left in place
+  while (count) {
+
+    Shard &s = take();
+    for (; count && s.count_.load(std::memory_order_relaxed); --count)
+      s.pop_front();
+    s.cs_.leave();
+  }
+}
+
+template<typename T, uint32 _S, uint32 _N> inline void ShardedPipe<T, _S, _N>::push(T &t) {
+
+  Shard &s = shard();
+  s.cs_.enter();
+  s.emplace(t);
+  s.cs_.leave();
+  release();
+}
+
+template<typename T, uint32 _S, uint32 _N> inline void ShardedPipe<T, _S, _N>::push(T &&t) {
+
+  Shard &s = shard();
+  s.cs_.enter();
+  s.emplace(std::move(t));
+  s.cs_.leave();
+  release();
+}
+
+template<typename T, uint32 _S, uint32 _N> template<typename... Args> inline void ShardedPipe<T, _S, _N>::emplace(Args &&... args) {
+
+  Shard &s = shard();
+  s.cs_.enter();
+  s.emplace(std::forward<Args>(args)...);
+  s.cs_.leave();
+  release();
+}
+
+template<typename T, uint32 _S, uint32 _N> inline void ShardedPipe<T, _S, _N>::push(const T *items, uint32 n) {
+
+  if (!n)
+    return;
+  Shard &s = shard();
+  s.cs_.enter();
+  for (uint32 i = 0; i < n; ++i)
+    s.emplace(items[i]);
+  s.cs_.leave();
+  release(n);
+}
+
+template<typename T, uint32 _S, uint32 _N> inline T ShardedPipe<T, _S, _N>::pop() {
+
+  acquire();
+  Shard &s = take();
+  T t(std::move(*s.front())); // T need not be default constructible
+  s.pop_front();
+  s.cs_.leave();
+  return t;
+}
+
+template<typename T, uint32 _S, uint32 _N> inline uint32 ShardedPipe<T, _S, _N>::pop(T *out, uint32 max, uint32 timeout) {
+
+  uint32 n = acquire(max, timeout);
+  _pop(out, n);
+  return n;
+}
+
+template<typename T, uint32 _S, uint32 _N> inline bool ShardedPipe<T, _S, _N>::try_pop(T &t) {
+
+  if (!try_acquire())
+    return false;
+  _pop(t);
+  return true;
+}
+
+template<typename T, uint32 _S, uint32 _N> inline bool ShardedPipe<T, _S, _N>::pop_until(T &t, Timestamp deadline) {
+
+  uint32 timeout = TimeoutUntil(deadline);
+  if (timeout ? acquire(timeout) : !try_acquire())
+    return false;
+  _pop(t);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T, uint32 _S, uint32 _C> BroadcastPipe<T, _S, _C>::Consumer::Consumer() : pipe_(NULL), sequence_(0), active_(false), dropped_(false), busy_(false), sleeping_(false), wake_(0, 65535) {
+}
+
+template<typename T, uint32 _S, uint32 _C> inline bool BroadcastPipe<T, _S, _C>::Consumer::read(T &t) {
+
+  uint64 sequence = sequence_.load(std::memory_order_relaxed); // only this consumer changes it
+  if (sequence == pipe_->cursor_.load(std::memory_order_acquire))
+    return false;
+  if (pipe_->policy_ == DropSlow) {
+
+    busy_.store(true);
+    if (dropped_.load()) {
+
+      busy_.store(false);
+      return false;
+    }
+    t = pipe_->ring_[sequence & (_S - 1)];
+    busy_.store(false, std::memory_order_release);
+  } else
+    t = pipe_->ring_[sequence & (_S - 1)];
+  sequence_.store(sequence + 1);
+  pipe_->advanced();
+  return true;
+}
+
+template<typename T, uint32 _S, uint32 _C> inline bool BroadcastPipe<T, _S, _C>::Consumer::pop(T &t) {
+
+  return pop_until(t, Timestamp::max());
+}
+
+template<typename T, uint32 _S, uint32 _C> inline bool BroadcastPipe<T, _S, _C>::Consumer::try_pop(T &t) {
+
+  return !dropped_.load(std::memory_order_relaxed) && read(t);
+}
+
+template<typename T, uint32 _S, uint32 _C> bool BroadcastPipe<T, _S, _C>::Consumer::pop_until(T &t, Timestamp deadline) {
+
+  for (;;) {
+
+    if (dropped_.load(std::memory_order_relaxed))
+      return false;
+    if (read(t))
+      return true;
+    uint32 timeout = LightweightSemaphore::TimeoutUntil(deadline);
+    if (!timeout)
+      return false;
+    pipe_->sleepers_.fetch_add(1);
+    sleeping_.store(true);
+    if (sequence_.load(std::memory_order_relaxed) == pipe_->cursor_.load() && !dropped_.load()) // still nothing: the writer will see sleeping_
+      wake_.acquire(timeout);
+    sleeping_.store(false);
+    pipe_->sleepers_.fetch_sub(1);
+  }
+}
+
+template<typename T, uint32 _S, uint32 _C> inline bool BroadcastPipe<T, _S, _C>::Consumer::dropped() const {
+
+  return dropped_.load(std::memory_order_relaxed);
+}
+
+template<typename T, uint32 _S, uint32 _C> inline uint64 BroadcastPipe<T, _S, _C>::Consumer::lag() const {
+
+  return pipe_->cursor_.load(std::memory_order_relaxed) - sequence_.load(std::memory_order_relaxed);
+}
+
+template<typename T, uint32 _S, uint32 _C> BroadcastPipe<T, _S, _C>::BroadcastPipe(Policy policy) : policy_(policy), cursor_(0), gating_(0), waiting_(false), room_(0, 65535), sleepers_(0) {
+
+  ring_ = new T[_S];
+  for (uint32 i = 0; i < _C; ++i)
+    consumers_[i].pipe_ = this;
+}
+
+template<typename T, uint32 _S, uint32 _C> BroadcastPipe<T, _S, _C>::~BroadcastPipe() {
+
+  delete[] ring_;
+}
+
+template<typename T, uint32 _S, uint32 _C> typename BroadcastPipe<T, _S, _C>::Consumer *BroadcastPipe<T, _S, _C>::subscribe() {
+
+  subscriptionCS_.enter();
+  for (uint32 i = 0; i < _C; ++i) {
+
+    Consumer &c = consumers_[i];
+    if (c.active_.load(std::memory_order_relaxed))
+      continue;
+    c.dropped_.store(false);
+    c.sequence_.store(cursor_.load());
+    c.active_.store(true); // the writer may not have seen it yet: its sequence is ahead of any the writer gates on
+    subscriptionCS_.leave();
+    return &c;
+  }
+  subscriptionCS_.leave();
+  return NULL;
+}
+
+template<typename T, uint32 _S, uint32 _C> void BroadcastPipe<T, _S, _C>::unsubscribe(Consumer *c) {
+
+  subscriptionCS_.enter();
+  c->active_.store(false);
+  subscriptionCS_.leave();
+  advanced(); // the writer may have been waiting for it
+}
+
+template<typename T, uint32 _S, uint32 _C> uint64 BroadcastPipe<T, _S, _C>::gate(uint64 sequence) {
+
+  uint64 min = sequence;
+  for (uint32 i = 0; i < _C; ++i) {
+
+    Consumer &c = consumers_[i];
+    if (!c.active_.load() || c.dropped_.load(std::memory_order_relaxed))
+      continue;
+    uint64 s = c.sequence_.load();
+    if (policy_ == DropSlow && sequence - s >= _S) { // the next item overwrites the one it has not read yet
+
+      c.dropped_.store(true);
+      while (c.busy_.load()) // copying it
+        std::this_thread::yield();
+      if (c.sleeping_.load() && c.sleeping_.exchange(false))
+        c.wake_.release();
+      continue;
+    }
+    if (s < min)
+      min = s;
+  }
+  return min;
+}
+
+template<typename T, uint32 _S, uint32 _C> bool BroadcastPipe<T, _S, _C>::room(bool wait) {
+
+  uint64 sequence = cursor_.load(std::memory_order_relaxed); // only the writer changes it
+  if (sequence - gating_ < _S)
+    return true;
+  while (sequence - (gating_ = gate(sequence)) >= _S) {
+
+    if (!wait)
+      return false;
+    waiting_.store(true);
+    if (sequence - (gating_ = gate(sequence)) < _S) { // a consumer has moved on meanwhile
+
+      waiting_.store(false);
+      return true;
+    }
+    room_.acquire();
+  }
+  return true;
+}
+
+template<typename T, uint32 _S, uint32 _C> inline void BroadcastPipe<T, _S, _C>::publish() {
+
+  cursor_.fetch_add(1);
+  if (sleepers_.load() > 0)
+    for (uint32 i = 0; i < _C; ++i) {
+
+      Consumer &c = consumers_[i];
+      if (c.sleeping_.load(std::memory_order_relaxed) && c.sleeping_.exchange(false))
+        c.wake_.release();
+    }
+}
+
+template<typename T, uint32 _S, uint32 _C> inline void BroadcastPipe<T, _S, _C>::advanced() {
+
+  if (waiting_.load() && waiting_.exchange(false))
+    room_.release();
+}
+
+template<typename T, uint32 _S, uint32 _C> inline void BroadcastPipe<T, _S, _C>::push(const T &t) {
+
+  room(true);
+  ring_[cursor_.load(std::memory_order_relaxed) & (_S - 1)] = t;
+  publish();
+}
+
+template<typename T, uint32 _S, uint32 _C> inline void BroadcastPipe<T, _S, _C>::push(T &&t) {
+
+  room(true);
+  ring_[cursor_.load(std::memory_order_relaxed) & (_S - 1)] = std::move(t);
+  publish();
+}
+
+template<typename T, uint32 _S, uint32 _C> inline bool BroadcastPipe<T, _S, _C>::try_push(const T &t) {
+
+  if (!room(false))
+    return false;
+  ring_[cursor_.load(std::memory_order_relaxed) & (_S - 1)] = t;
+  publish();
+  return true;
+}
+
+template<typename T, uint32 _S, uint32 _C> inline uint64 BroadcastPipe<T, _S, _C>::pushed() const {
+
+  return cursor_.load(std::memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T> DelayPipe<T>::DelayPipe() : pushes_(0), sleepers_(0), wake_(0, 65535) {
+}
+
+template<typename T> DelayPipe<T>::~DelayPipe() {
+}
+
+template<typename T> void DelayPipe<T>::clear() {
+
+  cs_.enter();
+  heap_.clear();
+  cs_.leave();
+}
+
+template<typename T> inline void DelayPipe<T>::pushed() {
+
+  ++pushes_;
+  bool earliest = heap_.size() == 1 || heap_.front() < heap_.back(); // the new item goes on top
+  std::push_heap(heap_.begin(), heap_.end());
+  uint32 sleepers = sleepers_;
+  cs_.leave();
+  if (earliest && sleepers) // they sleep until a later deadline: one of them is to wait for this one instead
+    wake_.release();
+}
+
+template<typename T> void DelayPipe<T>::push(const T &t, Timestamp deadline) {
+
+  cs_.enter();
+  heap_.push_back(Entry(deadline, pushes_, t));
+  pushed();
+}
+
+template<typename T> void DelayPipe<T>::push(T &&t, Timestamp deadline) {
+
+  cs_.enter();
+  heap_.push_back(Entry(deadline, pushes_, std::move(t)));
+  pushed();
+}
+
+template<typename T> bool DelayPipe<T>::wait(Timestamp deadline) {
+
+  cs_.enter();
+  for (;;) {
+
+    Timestamp now = Time::Get();
+    if (!heap_.empty() && heap_.front().deadline_ <= now)
+      return true;
+    if (deadline <= now) {
+
+      cs_.leave();
+      return false;
+    }
+    Timestamp wakeup = heap_.empty() || deadline < heap_.front().deadline_ ? deadline : heap_.front().deadline_;
+    ++sleepers_;
+    cs_.leave();
+    wake_.acquire(LightweightSemaphore::TimeoutUntil(wakeup));
+    cs_.enter();
+    --sleepers_;
+  }
+}
+
+template<typename T> T DelayPipe<T>::take() {
+
+  std::pop_heap(heap_.begin(), heap_.end());
+  T t(std::move(heap_.back().item_));
+  heap_.pop_back();
+  bool next = !heap_.empty() && sleepers_; // the new top may be due before the sleepers wake up, e.g. at the same deadline
+  cs_.leave();
+  if (next)
+    wake_.release();
+  return t;
+}
+
+template<typename T> T DelayPipe<T>::pop() {
+
+  wait(Timestamp::max());
+  return take();
+}
+
+template<typename T> bool DelayPipe<T>::try_pop(T &t) {
+
+  if (!wait(Timestamp::min()))
+    return false;
+  t = take();
+  return true;
+}
+
+template<typename T> bool DelayPipe<T>::pop_until(T &t, Timestamp deadline) {
+
+  if (!wait(deadline))
+    return false;
+  t = take();
+  return true;
+}
+
+template<typename T> uint32 DelayPipe<T>::size() {
+
+  cs_.enter();
+  uint32 size = heap_.size();
+  cs_.leave();
+  return size;
+}
+
+template<typename T> Timestamp DelayPipe<T>::next() {
+
+  cs_.enter();
+  Timestamp next = heap_.empty() ? Timestamp::max() : heap_.front().deadline_;
+  cs_.leave();
+  return next;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename K, typename T, class Hash> CoalescingPipe<K, T, Hash>::CoalescingPipe() : LightweightSemaphore(0), coalesced_(0) {
+}
+
+template<typename K, typename T, class Hash> CoalescingPipe<K, T, Hash>::~CoalescingPipe() {
+}
+
+template<typename K, typename T, class Hash> void CoalescingPipe<K, T, Hash>::clear() {
+
+  cs_.enter();
+  uint32 count = try_acquire(keys_.size()); // readers may have acquired some already: leave them theirs
+  for (uint32 i = 0; i < count; ++i) {
+
+    values_.erase(keys_.back());
+    keys_.pop_back();
+  }
+  cs_.leave();
+}
+
+template<typename K, typename T, class Hash> bool CoalescingPipe<K, T, Hash>::push(const K &key, const T &t) {
+
+  cs_.enter();
+  std::pair<typename std::unordered_map<K, T, Hash>::iterator, bool> v = values_.insert(std::make_pair(key, t));
+  if (!v.second) {
+
+    v.first->second = t;
+    ++coalesced_;
+    cs_.leave();
+    return false;
+  }
+  keys_.push_back(key);
+  cs_.leave();
+  release();
+  return true;
+}
+
+template<typename K, typename T, class Hash> bool CoalescingPipe<K, T, Hash>::push(const K &key, T &&t) {
+
+  cs_.enter();
+  typename std::unordered_map<K, T, Hash>::iterator v = values_.find(key);
+  if (v != values_.end()) {
+
+    v->second = std::move(t);
+    ++coalesced_;
+    cs_.leave();
+    return false;
+  }
+  values_.insert(std::make_pair(key, std::move(t)));
+  keys_.push_back(key);
+  cs_.leave();
+  release();
+  return true;
+}
+
+template<typename K, typename T, class Hash> inline void CoalescingPipe<K, T, Hash>::take(K &key, T &t) {
+
+  cs_.enter();
+  key = std::move(keys_.front());
+  keys_.pop_front();
+  typename std::unordered_map<K, T, Hash>::iterator v = values_.find(key);
+  t = std::move(v->second);
+  values_.erase(v);
+  cs_.leave();
+}
+
+template<typename K, typename T, class Hash> void CoalescingPipe<K, T, Hash>::pop(K &key, T &t) {
+
+  acquire();
+  take(key, t);
+}
+
+template<typename K, typename T, class Hash> bool CoalescingPipe<K, T, Hash>::try_pop(K &key, T &t) {
+
+  if (!try_acquire())
+    return false;
+  take(key, t);
+  return true;
+}
+
+template<typename K, typename T, class Hash> bool CoalescingPipe<K, T, Hash>::pop_until(K &key, T &t, Timestamp deadline) {
+
+  uint32 timeout = TimeoutUntil(deadline);
+  if (timeout ? acquire(timeout) : !try_acquire())
+    return false;
+  take(key, t);
+  return true;
+}
+
+template<typename K, typename T, class Hash> uint32 CoalescingPipe<K, T, Hash>::size() {
+
+  cs_.enter();
+  uint32 size = keys_.size();
+  cs_.leave();
+  return size;
+}
+
+template<typename K, typename T, class Hash> uint64 CoalescingPipe<K, T, Hash>::coalesced() {
+
+  cs_.enter();
+  uint64 coalesced = coalesced_;
+  cs_.leave();
+  return coalesced;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<class C> IntrusivePipeN1<C>::IntrusivePipeN1() : LightweightSemaphore(0), head_(&stub_), tail_(&stub_) {
+}
+
+template<class C> IntrusivePipeN1<C>::~IntrusivePipeN1() {
+
+  clear();
+}
+
+template<class C> void IntrusivePipeN1<C>::clear() {
+
+  while (try_acquire())
+    take()->decRef();
+}
+
+template<class C> inline void IntrusivePipeN1<C>::link(PipeLink *l) {
+
+  l->next_.store(NULL, std::memory_order_relaxed);
+  PipeLink *previous = head_.exchange(l, std::memory_order_acq_rel);
+  previous->next_.store(l, std::memory_order_release); // until then, the reader cannot get past previous
+}
+
+template<class C> inline C *IntrusivePipeN1<C>::_pop() {
+
+  PipeLink *tail = tail_;
+  PipeLink *next = tail->next_.load(std::memory_order_acquire);
+  if (tail == &stub_) {
+
+    if (!next)
+      return NULL;
+    tail_ = tail = next;
+    next = next->next_.load(std::memory_order_acquire);
+  }
+  if (next) {
+
+    tail_ = next;
+    return static_cast<C *>(tail);
+  }
+  if (tail != head_.load(std::memory_order_acquire)) // a writer has exchanged head_ but not linked its message yet
+    return NULL;
+  link(&stub_); // tail is the last one: the stub takes its place
+  next = tail->next_.load(std::memory_order_acquire);
+  if (next) {
+
+    tail_ = next;
+    return static_cast<C *>(tail);
+  }
+  return NULL;
+}
+
+template<class C> inline C *IntrusivePipeN1<C>::take() {
+
+  C *c;
+  while (!(c = _pop()))
+    std::this_thread::yield();
+  return c;
+}
+
+template<class C> inline void IntrusivePipeN1<C>::push(C *c) {
+
+  c->incRef(); // released by the reader
+  link(c);
+  release();
+}
+
+template<class C> inline P<C> IntrusivePipeN1<C>::pop() {
+
+  acquire();
+  C *c = take();
+  P<C> p(c);
+  c->decRef();
+  return p;
+}
+
+template<class C> inline bool IntrusivePipeN1<C>::try_pop(P<C> &p) {
+
+  if (!try_acquire())
+    return false;
+  C *c = take();
+  p = c;
+  c->decRef();
+  return true;
+}
+
+template<class C> inline bool IntrusivePipeN1<C>::pop_until(P<C> &p, Timestamp deadline) {
+
+  uint32 timeout = TimeoutUntil(deadline);
+  if (timeout ? acquire(timeout) : !try_acquire())
+    return false;
+  C *c = take();
+  p = c;
+  c->decRef();
+  return true;
+}
+
+#if defined LINUX
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T, uint32 _S, template<typename, uint32> class P> SpillPipe<T, _S, P>::SpillPipe(const char *path, uint32 watermark) : LightweightSemaphore(0),
+  watermark_(watermark),
+  spilling_(false),
+  tailCount_(0),
+  front_(NULL),
+  mapped_(false),
+  frontCount_(0),
+  frontRead_(0),
+  spilled_(0),
+  lost_(0),
+  owed_(0) {
+
+  file_.open(path, _S * sizeof(T)); // on failure, chunks stay in memory
+  tail_ = (T *)Memory::AlignedAllocate(_S * sizeof(T));
+  buffer_ = (T *)Memory::AlignedAllocate(_S * sizeof(T));
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> SpillPipe<T, _S, P>::~SpillPipe() {
+
+  drop();
+  for (typename std::deque<T *>::iterator c = chunks_.begin(); c != chunks_.end(); ++c)
+    if (*c)
+      Memory::AlignedFree(*c);
+  Memory::AlignedFree(tail_);
+  Memory::AlignedFree(buffer_);
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> void SpillPipe<T, _S, P>::spill(const T &t) {
+
+  spillCS_.enter();
+  spilling_.store(true);
+  tail_[tailCount_++] = t;
+  ++spilled_;
+  if (tailCount_ == _S) {
+
+    if (file_.append(tail_))
+      chunks_.push_back(NULL);
+    else {
+
+      chunks_.push_back(tail_);
+      tail_ = (T *)Memory::AlignedAllocate(_S * sizeof(T));
+    }
+    tailCount_ = 0;
+  }
+  spillCS_.leave();
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> void SpillPipe<T, _S, P>::drop() {
+
+  if (front_ && front_ != buffer_) {
+
+    if (mapped_)
+      file_.unmap(front_);
+    else
+      Memory::AlignedFree((T *)front_);
+  }
+  front_ = NULL;
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> bool SpillPipe<T, _S, P>::next() {
+
+  drop();
+  frontRead_ = 0;
+  while (!chunks_.empty()) {
+
+    T *chunk = chunks_.front();
+    chunks_.pop_front();
+    mapped_ = false;
+    if (chunk)
+      front_ = chunk;
+    else if ((front_ = (const T *)file_.map()) != NULL)
+      mapped_ = true;
+    else { // the mapping failed: the chunk is still in the file, to be read into memory
+
+      chunk = (T *)Memory::AlignedAllocate(_S * sizeof(T));
+      if (file_.read(chunk))
+        front_ = chunk;
+      else {
+
+        Memory::AlignedFree(chunk);
+        lose();
+      }
+    }
+    if (front_) {
+
+      frontCount_ = _S;
+      return true;
+    }
+  }
+  if (tailCount_) { // the writers' buffer, now that they go on with an empty one
+
+    std::swap(tail_, buffer_);
+    front_ = buffer_;
+    frontCount_ = tailCount_;
+    tailCount_ = 0;
+    return true;
+  }
+  frontCount_ = 0;
+  file_.reset();
+  spilling_.store(false); // writers go back to memory
+  return false;
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> void SpillPipe<T, _S, P>::lose() {
+
+  std::cerr << "> Error: " << _S << " items of a SpillPipe lost with a chunk of its file" << std::endl;
+  file_.skip();
+  spilled_ -= _S;
+  lost_ += _S;
+  owed_.fetch_add(_S - try_acquire(_S)); // the units readers have acquired already
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline bool SpillPipe<T, _S, P>::_pop(T *t) {
+
+  for (;;) {
+
+    PipeSlot<T> slot;
+    if (memory_.try_peek(slot)) { // items pushed to memory before spilling started come first
+
+      new (t) T(*slot.item_);
+      memory_.release(slot);
+      return true;
+    }
+    if (spilling_.load() || owed_.load()) {
+
+      spillCS_.enter();
+      if (spilling_.load() && (frontRead_ < frontCount_ || next())) {
+
+        new (t) T(front_[frontRead_++]);
+        --spilled_;
+        if (frontRead_ == frontCount_)
+          next();
+        spillCS_.leave();
+        return true;
+      }
+      uint32 owed = owed_.load();
+      if (owed) { // our unit was one of a lost item
+
+        owed_.store(owed - 1);
+        spillCS_.leave();
+        return false;
+      }
+      spillCS_.leave();
+    }
+    std::this_thread::yield(); // the writer of the item acquired is about to make it visible
+  }
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline void SpillPipe<T, _S, P>::push(const T &t) {
+
+  if (spilling_.load() || memory_.count() >= watermark_)
+    spill(t);
+  else
+    memory_.emplace(t);
+  release();
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline T SpillPipe<T, _S, P>::pop() {
+
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type item; // T need not be default constructible
+  do
+    acquire();
+  while (!_pop(reinterpret_cast<T *>(&item)));
+  return *reinterpret_cast<T *>(&item);
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline bool SpillPipe<T, _S, P>::try_pop(T &t) {
+
+  while (try_acquire())
+    if (_pop(&t))
+      return true;
+  return false;
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> inline bool SpillPipe<T, _S, P>::pop_until(T &t, Timestamp deadline) {
+
+  for (;;) {
+
+    uint32 timeout = TimeoutUntil(deadline);
+    if (timeout ? acquire(timeout) : !try_acquire())
+      return false;
+    if (_pop(&t))
+      return true;
+  }
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> uint64 SpillPipe<T, _S, P>::spilled() {
+
+  spillCS_.enter();
+  uint64 spilled = spilled_;
+  spillCS_.leave();
+  return spilled;
+}
+
+template<typename T, uint32 _S, template<typename, uint32> class P> uint64 SpillPipe<T, _S, P>::lost() {
+
+  spillCS_.enter();
+  uint64 lost = lost_;
+  spillCS_.leave();
+  return lost;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T, uint32 _S> size_t SharedPipe<T, _S>::Bytes() {
+
+  return sizeof(Header) + _S * sizeof(Cell);
+}
+
+template<typename T, uint32 _S> SharedPipe<T, _S>::SharedPipe() : header_(NULL), cells_(NULL), side_(Writer) {
+}
+
+template<typename T, uint32 _S> SharedPipe<T, _S>::~SharedPipe() {
+
+  close();
+}
+
+template<typename T, uint32 _S> SharedPipe<T, _S> *SharedPipe<T, _S>::create(const char *name, Side side) {
+
+  close();
+  if (!memory_.create(name, Bytes()))
+    return NULL;
+  header_ = (Header *)memory_.base(); // zero-filled
+  cells_ = (Cell *)(header_ + 1);
+  header_->size_ = _S;
+  header_->itemSize_ = sizeof(T);
+  header_->items_.init(0);
+  header_->room_.init(_S);
+  for (uint32 i = 0; i < _S; ++i)
+    cells_[i].sequence_.store(i, std::memory_order_relaxed);
+  header_->magic_.store(Magic, std::memory_order_release);
+  return attach(side);
+}
+
+template<typename T, uint32 _S> SharedPipe<T, _S> *SharedPipe<T, _S>::open(const char *name, Side side) {
+
+  close();
+  if (!memory_.open(name, Bytes()))
+    return NULL;
+  header_ = (Header *)memory_.base();
+  cells_ = (Cell *)(header_ + 1);
+  if (header_->magic_.load(std::memory_order_acquire) != Magic) { // the creator is still initializing it
+
+    close();
+    return NULL;
+  }
+  if (header_->size_ != _S || header_->itemSize_ != sizeof(T)) {
+
+    std::cerr << "> Error: shared memory " << name << " holds another kind of pipe" << std::endl;
+    close();
+    return NULL;
+  }
+  return attach(side);
+}
+
+template<typename T, uint32 _S> SharedPipe<T, _S> *SharedPipe<T, _S>::attach(Side side) {
+
+  if (!header_->peers_[side].attach()) {
+
+    std::cerr << "> Error: too many processes attached to a shared pipe" << std::endl;
+    header_ = NULL;
+    memory_.close();
+    return NULL;
+  }
+  side_ = side;
+  return this;
+}
+
+template<typename T, uint32 _S> void SharedPipe<T, _S>::close() {
+
+  if (header_)
+    header_->peers_[side_].detach();
+  header_ = NULL;
+  cells_ = NULL;
+  memory_.close();
+}
+
+template<typename T, uint32 _S> bool SharedPipe<T, _S>::wait(SharedSemaphore &s, Timestamp deadline) {
+
+  for (;;) {
+
+    uint32 timeout = LightweightSemaphore::TimeoutUntil(deadline);
+    if (!s.acquire(timeout < PeerCheckPeriod ? timeout : PeerCheckPeriod))
+      return true;
+    if (peerGone()) // readers still drain the ring
+      return side_ == Reader && s.try_acquire();
+    if (!timeout)
+      return false;
+  }
+}
+
+template<typename T, uint32 _S> bool SharedPipe<T, _S>::ready(Cell &cell, uint64 sequence, Timestamp deadline) {
+
+  Timestamp check = Time::Get() + std::chrono::milliseconds(PeerCheckPeriod);
+  for (uint32 spins = 1; cell.sequence_.load(std::memory_order_acquire) != sequence; ++spins) { // the other side is still copying its item
+
+    std::this_thread::yield();
+    if (spins % 64)
+      continue;
+    Timestamp now = Time::Get();
+    if (now < check)
+      continue;
+    if (peerGone() || now >= deadline) // the other side died in the middle of its push or pop, or is late
+      return cell.sequence_.load(std::memory_order_acquire) == sequence;
+    check = now + std::chrono::milliseconds(PeerCheckPeriod);
+  }
+  return true;
+}
+
+template<typename T, uint32 _S> inline bool SharedPipe<T, _S>::write(const T &t, Timestamp deadline) {
+
+  uint64 ticket = header_->tail_.fetch_add(1, std::memory_order_relaxed);
+  Cell &cell = cells_[ticket & (_S - 1)];
+  if (!ready(cell, ticket, deadline)) // the reader of the previous item there is still copying it
+    return false;
+  cell.item_ = t;
+  cell.sequence_.store(ticket + 1, std::memory_order_release);
+  header_->items_.release();
+  return true;
+}
+
+template<typename T, uint32 _S> inline bool SharedPipe<T, _S>::read(T &t, Timestamp deadline) {
+
+  uint64 ticket = header_->head_.fetch_add(1, std::memory_order_relaxed);
+  Cell &cell = cells_[ticket & (_S - 1)];
+  if (!ready(cell, ticket + 1, deadline)) // the writer is still copying the item
+    return false;
+  t = cell.item_;
+  cell.sequence_.store(ticket + _S, std::memory_order_release);
+  header_->room_.release();
+  return true;
+}
+
+template<typename T, uint32 _S> inline bool SharedPipe<T, _S>::push(const T &t) {
+
+  return push_until(t, Timestamp::max());
+}
+
+template<typename T, uint32 _S> inline bool SharedPipe<T, _S>::try_push(const T &t) {
+
+  if (!header_->room_.try_acquire())
+    return false;
+  return write(t, Time::Get());
+}
+
+template<typename T, uint32 _S> inline bool SharedPipe<T, _S>::push_until(const T &t, Timestamp deadline) {
+
+  if (!header_->room_.try_acquire() && !wait(header_->room_, deadline))
+    return false;
+  return write(t, deadline);
+}
+
+template<typename T, uint32 _S> inline bool SharedPipe<T, _S>::pop(T &t) {
+
+  return pop_until(t, Timestamp::max());
+}
+
+template<typename T, uint32 _S> inline bool SharedPipe<T, _S>::try_pop(T &t) {
+
+  if (!header_->items_.try_acquire())
+    return false;
+  return read(t, Time::Get());
+}
+
+template<typename T, uint32 _S> inline bool SharedPipe<T, _S>::pop_until(T &t, Timestamp deadline) {
+
+  if (!header_->items_.try_acquire() && !wait(header_->items_, deadline))
+    return false;
+  return read(t, deadline);
+}
+
+template<typename T, uint32 _S> inline uint32 SharedPipe<T, _S>::size() const {
+
+  return header_->items_.count();
+}
+
+template<typename T, uint32 _S> bool SharedPipe<T, _S>::peerGone() {
+
+  return header_->peers_[side_ == Writer ? Reader : Writer].gone();
 }
 #endif
 }
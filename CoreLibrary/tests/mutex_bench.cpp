@@ -0,0 +1,183 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA
+//_/_/ Autocatalytic Endogenous Reflective Architecture
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/ 
+//_/_/ Copyright (c) 2010-2012 Eric Nivel, Thor List
+//_/_/ Center for Analysis and Design of Intelligent Agents
+//_/_/ Reykjavik University, Menntavegur 1, 102 Reykjavik, Iceland
+//_/_/ http://cadia.ru.is
+//_/_/ 
+//_/_/ Part of this software was developed by Eric Nivel
+//_/_/ in the HUMANOBS EU research project, which included
+//_/_/ the following parties:
+//_/_/
+//_/_/ Autonomous Systems Laboratory
+//_/_/ Technical University of Madrid, Spain
+//_/_/ http://www.aslab.org/
+//_/_/
+//_/_/ Communicative Machines
+//_/_/ Edinburgh, United Kingdom
+//_/_/ http://www.cmlabs.com/
+//_/_/
+//_/_/ Istituto Dalle Molle di Studi sull'Intelligenza Artificiale
+//_/_/ University of Lugano and SUPSI, Switzerland
+//_/_/ http://www.idsia.ch/
+//_/_/
+//_/_/ Institute of Cognitive Sciences and Technologies
+//_/_/ Consiglio Nazionale delle Ricerche, Italy
+//_/_/ http://www.istc.cnr.it/
+//_/_/
+//_/_/ Dipartimento di Ingegneria Informatica
+//_/_/ University of Palermo, Italy
+//_/_/ http://diid.unipa.it/roboticslab/
+//_/_/
+//_/_/
+//_/_/ --- HUMANOBS Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+// Contention on a Mutex taken with a timeout: Threads threads, from 2 up to MaxThreads, doubling, each loop for Duration taking
+// the mutex, holding it for Hold spins, and spinning as long outside. Mutex::acquire(timeout) is compared with the loop it
+// replaced, which tried the lock every 10 ms until the timeout. Prints the acquisitions per second and the distribution of the
+// waits for the lock, in microseconds. Linux only.
+// Usage: mutex_bench [max threads]; defaults to 8.
+
+#include "utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+
+using namespace core;
+
+static const uint32 Timeout = 1000; // ms: long enough never to expire
+static const uint32 Hold = 200; // spins
+static const std::chrono::milliseconds Duration(1000);
+
+typedef std::chrono::steady_clock Clock;
+
+static void Spin(uint32 work) {
+
+  uint64 x = work;
+  for (uint32 i = 0; i < work; ++i)
+    x = x * 6364136223846793005ull + 1442695040888963407ull;
+  __asm__ __volatile__("" : : "r"(x)); // keeps the loop
+}
+
+// The timed acquire as it was: a try every 10 ms.
+class SleepPollMutex {
+private:
+  pthread_mutex_t m_;
+public:
+  SleepPollMutex() { pthread_mutex_init(&m_, NULL); }
+  ~SleepPollMutex() { pthread_mutex_destroy(&m_); }
+  bool acquire(uint32 timeout) {
+
+    Clock::time_point start = Clock::now();
+    while (pthread_mutex_trylock(&m_) != 0) {
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      if (Clock::now() - start >= std::chrono::milliseconds(timeout))
+        return true;
+    }
+    return false;
+  }
+  void release() { pthread_mutex_unlock(&m_); }
+};
+
+template<class M> void Run(const char *name, uint32 threads) {
+
+  M mutex;
+  std::vector<std::vector<double> > waits(threads);
+  std::vector<std::thread> running;
+  Clock::time_point end = Clock::now() + Duration;
+  for (uint32 i = 0; i < threads; ++i)
+    running.push_back(std::thread([&mutex, &waits, i, end]() {
+
+      std::vector<double> &w = waits[i];
+      for (;;) {
+
+        Clock::time_point start = Clock::now();
+        if (start >= end)
+          break;
+        if (mutex.acquire(Timeout)) {
+
+          std::cerr << "> Error: timed out" << std::endl;
+          continue;
+        }
+        w.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        Spin(Hold);
+        mutex.release();
+        Spin(Hold);
+      }
+    }));
+  for (uint32 i = 0; i < threads; ++i)
+    running[i].join();
+
+  std::vector<double> all;
+  for (uint32 i = 0; i < threads; ++i)
+    all.insert(all.end(), waits[i].begin(), waits[i].end());
+  std::sort(all.begin(), all.end());
+  if (all.empty())
+    return;
+  printf("%-10s %2u threads: %8.0f acquisitions/s, wait p50 %7.1f us, p99 %7.1f us, p99.9 %8.1f us, max %8.1f us\n", name, threads,
+    all.size() / std::chrono::duration<double>(Duration).count(), all[all.size() / 2], all[all.size() * 99 / 100], all[all.size() * 999 / 1000], all.back());
+}
+
+int main(int argc, char **argv) {
+
+  uint32 max = argc > 1 ? atoi(argv[1]) : 8;
+  for (uint32 threads = 2; threads <= max; threads *= 2) {
+
+    Run<SleepPollMutex>("sleep-poll", threads);
+    Run<Mutex>("Mutex", threads);
+  }
+  return 0;
+}
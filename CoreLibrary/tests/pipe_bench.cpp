@@ -0,0 +1,199 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA
+//_/_/ Autocatalytic Endogenous Reflective Architecture
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/ 
+//_/_/ Copyright (c) 2010-2012 Eric Nivel, Thor List
+//_/_/ Center for Analysis and Design of Intelligent Agents
+//_/_/ Reykjavik University, Menntavegur 1, 102 Reykjavik, Iceland
+//_/_/ http://cadia.ru.is
+//_/_/ 
+//_/_/ Part of this software was developed by Eric Nivel
+//_/_/ in the HUMANOBS EU research project, which included
+//_/_/ the following parties:
+//_/_/
+//_/_/ Autonomous Systems Laboratory
+//_/_/ Technical University of Madrid, Spain
+//_/_/ http://www.aslab.org/
+//_/_/
+//_/_/ Communicative Machines
+//_/_/ Edinburgh, United Kingdom
+//_/_/ http://www.cmlabs.com/
+//_/_/
+//_/_/ Istituto Dalle Molle di Studi sull'Intelligenza Artificiale
+//_/_/ University of Lugano and SUPSI, Switzerland
+//_/_/ http://www.idsia.ch/
+//_/_/
+//_/_/ Institute of Cognitive Sciences and Technologies
+//_/_/ Consiglio Nazionale delle Ricerche, Italy
+//_/_/ http://www.istc.cnr.it/
+//_/_/
+//_/_/ Dipartimento di Ingegneria Informatica
+//_/_/ University of Palermo, Italy
+//_/_/ http://diid.unipa.it/roboticslab/
+//_/_/
+//_/_/
+//_/_/ --- HUMANOBS Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+// Throughput of the PipeNN of the engine selected at compile time (build with -DPIPE_1 or -DPIPE_2), with W writers and R readers
+// pushing and popping one item at a time, then in batches. Each figure is the best of Runs runs, in millions of items per second.
+// First, the memory taken per queued item by a few block layouts: as laid out (BlockBytes()/_S), and as measured by the growth of
+// the heap (allocator overheads included) while Queued items are held; blocks served by mmap count as mapped, resident or not.
+// Then, a ShardedPipe against a PipeNN as the writers grow from 1 to MaxWriters, with as many readers as given, for Scaled items
+// in all, pushed and popped one at a time.
+// Usage: pipe_bench [writers readers [items per writer]]; defaults to 8 writers, 8 readers and 1000000 items each.
+
+#include "pipe.h"
+
+#include <chrono>
+#include <malloc.h>
+#include <vector>
+
+
+using namespace core;
+
+static const uint32 Runs = 3;
+static const uint32 Batch = 32;
+static const uint32 Queued = 1 << 20;
+static const uint32 MaxWriters = 32;
+static const uint64 Scaled = 4000000;
+
+#ifdef PIPE_1
+static const char *Engine = "PIPE_1";
+#else
+static const char *Engine = "PIPE_2";
+#endif
+
+static uint64 Allocated() { // bytes in use on the heap
+
+  struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+}
+
+template<typename T, uint32 _S> void Footprint(const char *name) {
+
+  PipeNN<T, _S> *pipe = new PipeNN<T, _S>();
+  uint64 before = Allocated();
+  for (uint32 i = 0; i < Queued; ++i)
+    pipe->push(T());
+  uint64 after = Allocated();
+  delete pipe;
+  uint32 block = PipeNN<T, _S>::BlockBytes();
+  printf("%s %-45s %7u bytes per block: %6.2f bytes per item laid out, %6.2f measured\n", Engine, name, block, (double)block / _S, (double)(after - before) / Queued);
+}
+
+template<class P> double Run(uint32 writers, uint32 readers, uint64 count, uint32 batch) {
+
+  P *pipe = new P();
+  std::atomic<uint64> popped(0);
+  const uint64 total = writers * count;
+  std::vector<std::thread> threads;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32 r = 0; r < readers; ++r)
+    threads.push_back(std::thread([pipe, &popped, total, batch]() {
+
+      uint64 out[Batch];
+      while (popped.load(std::memory_order_relaxed) < total) {
+
+        uint32 n = pipe->pop(out, batch, 1);
+        if (n)
+          popped.fetch_add(n, std::memory_order_relaxed);
+      }
+    }));
+  for (uint32 w = 0; w < writers; ++w)
+    threads.push_back(std::thread([pipe, count, batch]() {
+
+      uint64 items[Batch];
+      for (uint32 i = 0; i < batch; ++i)
+        items[i] = i;
+      if (batch == 1)
+        for (uint64 i = 0; i < count; ++i)
+          pipe->push(i);
+      else
+        for (uint64 i = 0; i < count; i += batch)
+          pipe->push(items, (uint32)(count - i < batch ? count - i : batch));
+    }));
+  for (uint32 i = 0; i < threads.size(); ++i)
+    threads[i].join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  delete pipe;
+  return total / seconds / 1e6;
+}
+
+template<class P> void Bench(const char *name, uint32 writers, uint32 readers, uint64 count, uint32 batch) {
+
+  double best = 0;
+  for (uint32 i = 0; i < Runs; ++i) {
+
+    double mops = Run<P>(writers, readers, count, batch);
+    if (mops > best)
+      best = mops;
+  }
+  printf("%s %s %ux%u, batch %2u: %8.2f Mops/s\n", Engine, name, writers, readers, batch, best);
+}
+
+int main(int argc, char **argv) {
+
+  uint32 writers = argc > 2 ? atoi(argv[1]) : 8;
+  uint32 readers = argc > 2 ? atoi(argv[2]) : 8;
+  uint64 count = argc > 3 ? strtoull(argv[3], NULL, 10) : 1000000;
+  Footprint<uint64, 1024>("PipeNN<uint64, 1024>");
+  Footprint<void *, 1000>("PipeNN<void *, 1000>");
+  Footprint<void *, PipeBlockBudget<void *, 4096>::Size>("PipeNN<void *, PipeBlockBudget<void *, 4096>>");
+  Footprint<uint64, PipeBlockBudget<uint64, Memory::HugePageSize>::Size>("PipeNN<uint64, PipeBlockBudget<uint64, 2MB>>");
+  Bench<PipeNN<uint64, 1024> >("PipeNN<uint64, 1024>", writers, readers, count, 1);
+  Bench<PipeNN<uint64, 1024> >("PipeNN<uint64, 1024>", writers, readers, count, Batch);
+  for (uint32 w = 1; w <= MaxWriters; w *= 2) {
+
+    Bench<PipeNN<uint64, 1024> >("PipeNN<uint64, 1024>         ", w, readers, Scaled / w, 1);
+    Bench<ShardedPipe<uint64, 1024> >("ShardedPipe<uint64, 1024, 16>", w, readers, Scaled / w, 1);
+  }
+  return 0;
+}
@@ -0,0 +1,338 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA
+//_/_/ Autocatalytic Endogenous Reflective Architecture
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/ 
+//_/_/ Copyright (c) 2010-2012 Eric Nivel, Thor List
+//_/_/ Center for Analysis and Design of Intelligent Agents
+//_/_/ Reykjavik University, Menntavegur 1, 102 Reykjavik, Iceland
+//_/_/ http://cadia.ru.is
+//_/_/ 
+//_/_/ Part of this software was developed by Eric Nivel
+//_/_/ in the HUMANOBS EU research project, which included
+//_/_/ the following parties:
+//_/_/
+//_/_/ Autonomous Systems Laboratory
+//_/_/ Technical University of Madrid, Spain
+//_/_/ http://www.aslab.org/
+//_/_/
+//_/_/ Communicative Machines
+//_/_/ Edinburgh, United Kingdom
+//_/_/ http://www.cmlabs.com/
+//_/_/
+//_/_/ Istituto Dalle Molle di Studi sull'Intelligenza Artificiale
+//_/_/ University of Lugano and SUPSI, Switzerland
+//_/_/ http://www.idsia.ch/
+//_/_/
+//_/_/ Institute of Cognitive Sciences and Technologies
+//_/_/ Consiglio Nazionale delle Ricerche, Italy
+//_/_/ http://www.istc.cnr.it/
+//_/_/
+//_/_/ Dipartimento di Ingegneria Informatica
+//_/_/ University of Palermo, Italy
+//_/_/ http://diid.unipa.it/roboticslab/
+//_/_/
+//_/_/
+//_/_/ --- HUMANOBS Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+// Stress test of the pipe engine selected at compile time (build with -DPIPE_1 or -DPIPE_2): writers push sequenced items, one at a
+// time or in batches, while readers pop them; each reader checks that the items of every writer come in the order they were pushed,
+// and every item is to be popped exactly once. Block sizes are not powers of 2, so that batches and tickets straddle blocks.
+// The ShardedPipe runs have fewer shards than writers, so that writers share shards.
+// Returns 0 if all runs pass.
+
+#include "pipe.h"
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+
+
+using namespace core;
+
+static const uint32 MaxWriters = 16;
+static const uint32 Batch = 50; // max items pushed at once
+static const uint32 PopBatch = 64; // max items popped at once
+static const uint32 LostAfter = 60000; // ms without the last items
+
+template<typename T> class Item;
+
+template<> class Item<uint64> {
+public:
+  static uint64 Make(uint64 value) { return value; }
+  static uint64 Value(const uint64 &t) { return t; }
+};
+
+template<> class Item<std::unique_ptr<uint64> > { // move-only
+public:
+  static std::unique_ptr<uint64> Make(uint64 value) { return std::unique_ptr<uint64>(new uint64(value)); }
+  static uint64 Value(const std::unique_ptr<uint64> &t) { return t ? *t : UINT64_MAX; }
+};
+
+// The items of all writers seen by all readers.
+class Ledger {
+private:
+  const uint32 writers_;
+  const uint64 count_; // per writer
+  std::vector<std::atomic<uint8> > seen_;
+  std::atomic_bool failed_;
+public:
+  static const uint64 Stop = UINT64_MAX - 1; // tells a reader to leave
+  static uint64 Encode(uint32 writer, uint64 sequence) { return ((uint64)writer << 40) | sequence; }
+
+  Ledger(uint32 writers, uint64 count) : writers_(writers), count_(count), seen_(writers * count), failed_(false) {
+
+    for (uint64 i = 0; i < seen_.size(); ++i)
+      seen_[i].store(0, std::memory_order_relaxed);
+  }
+
+  class Reader {
+  private:
+    Ledger &ledger_;
+    uint64 next_[MaxWriters]; // lowest sequence expected next, per writer
+  public:
+    Reader(Ledger &ledger) : ledger_(ledger) {
+
+      for (uint32 i = 0; i < MaxWriters; ++i)
+        next_[i] = 0;
+    }
+    void see(uint64 item) {
+
+      uint32 writer = (uint32)(item >> 40);
+      uint64 sequence = item & ((1ull << 40) - 1);
+      if (writer >= ledger_.writers_ || sequence >= ledger_.count_) {
+
+        ledger_.fail("corrupted item");
+        return;
+      }
+      if (sequence < next_[writer])
+        ledger_.fail("out of order");
+      next_[writer] = sequence + 1;
+      if (ledger_.seen_[writer * ledger_.count_ + sequence].fetch_add(1, std::memory_order_relaxed))
+        ledger_.fail("popped twice");
+    }
+  };
+
+  void fail(const char *what) {
+
+    if (!failed_.exchange(true))
+      std::cerr << "> Error: " << what << std::endl;
+  }
+
+  bool check() {
+
+    for (uint64 i = 0; i < seen_.size(); ++i)
+      if (seen_[i].load() != 1) {
+
+        fail("item lost");
+        break;
+      }
+    return !failed_.load();
+  }
+};
+
+// Single items: writers push (or emplace, or move), readers wait in pop() until each gets a Stop item, pushed once all items are in:
+// pipes with several queues inside (ShardedPipe) keep the order of each writer only.
+template<class P, typename T> bool RunSingle(const char *name, uint32 writers, uint32 readers, uint64 count) {
+
+  P *pipe = new P();
+  Ledger ledger(writers, count);
+  std::atomic<uint64> popped(0);
+  std::vector<std::thread> threads;
+  for (uint32 r = 0; r < readers; ++r)
+    threads.push_back(std::thread([pipe, &ledger, &popped]() {
+
+      Ledger::Reader reader(ledger);
+      for (;;) {
+
+        T t = pipe->pop();
+        uint64 item = Item<T>::Value(t);
+        if (item == Ledger::Stop)
+          break;
+        reader.see(item);
+        popped.fetch_add(1);
+      }
+    }));
+  std::vector<std::thread> writing;
+  for (uint32 w = 0; w < writers; ++w)
+    writing.push_back(std::thread([pipe, w, count]() {
+
+      for (uint64 i = 0; i < count; ++i)
+        if (i & 1) {
+
+          T t = Item<T>::Make(Ledger::Encode(w, i));
+          pipe->push(std::move(t));
+        } else
+          pipe->emplace(Item<T>::Make(Ledger::Encode(w, i)));
+    }));
+  for (uint32 w = 0; w < writers; ++w)
+    writing[w].join();
+  for (uint32 ms = 0; popped.load() < writers * count && ms < LostAfter; ++ms) // past that, the check reports the items lost
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  for (uint32 r = 0; r < readers; ++r)
+    pipe->emplace(Item<T>::Make(Ledger::Stop));
+  for (uint32 r = 0; r < readers; ++r)
+    threads[r].join();
+  delete pipe;
+
+  bool ok = ledger.check();
+  std::cout << (ok ? "ok     " : "FAILED ") << name << " single " << writers << "x" << readers << std::endl;
+  return ok;
+}
+
+// Batches: writers push runs of 1 to Batch items at once, readers pop up to PopBatch at once, with a timeout, until all items are in.
+template<class P> bool RunBatches(const char *name, uint32 writers, uint32 readers, uint64 count) {
+
+  P *pipe = new P();
+  Ledger ledger(writers, count);
+  std::atomic<uint64> popped(0);
+  const uint64 total = writers * count;
+  std::vector<std::thread> threads;
+  for (uint32 r = 0; r < readers; ++r)
+    threads.push_back(std::thread([pipe, &ledger, &popped, total]() {
+
+      Ledger::Reader reader(ledger);
+      uint64 out[PopBatch];
+      while (popped.load() < total) {
+
+        uint32 n = pipe->pop(out, PopBatch, 10);
+        for (uint32 i = 0; i < n; ++i)
+          reader.see(out[i]);
+        popped.fetch_add(n);
+      }
+    }));
+  for (uint32 w = 0; w < writers; ++w)
+    threads.push_back(std::thread([pipe, w, count]() {
+
+      std::minstd_rand random(w + 1);
+      uint64 items[Batch];
+      for (uint64 i = 0; i < count;) {
+
+        uint32 n = 1 + random() % Batch;
+        if (n > count - i)
+          n = (uint32)(count - i);
+        for (uint32 j = 0; j < n; ++j)
+          items[j] = Ledger::Encode(w, i + j);
+        pipe->push(items, n);
+        i += n;
+      }
+    }));
+  for (uint32 i = 0; i < threads.size(); ++i)
+    threads[i].join();
+  delete pipe;
+
+  bool ok = ledger.check();
+  std::cout << (ok ? "ok     " : "FAILED ") << name << " batches " << writers << "x" << readers << std::endl;
+  return ok;
+}
+
+// Move-only items popped in batches.
+template<class P> bool RunMoveBatches(const char *name, uint32 writers, uint32 readers, uint64 count) {
+
+  typedef std::unique_ptr<uint64> T;
+  P *pipe = new P();
+  Ledger ledger(writers, count);
+  std::atomic<uint64> popped(0);
+  const uint64 total = writers * count;
+  std::vector<std::thread> threads;
+  for (uint32 r = 0; r < readers; ++r)
+    threads.push_back(std::thread([pipe, &ledger, &popped, total]() {
+
+      Ledger::Reader reader(ledger);
+      T out[PopBatch];
+      while (popped.load() < total) {
+
+        uint32 n = pipe->pop(out, PopBatch, 10);
+        for (uint32 i = 0; i < n; ++i)
+          reader.see(*out[i]);
+        popped.fetch_add(n);
+      }
+    }));
+  for (uint32 w = 0; w < writers; ++w)
+    threads.push_back(std::thread([pipe, w, count]() {
+
+      for (uint64 i = 0; i < count; ++i)
+        pipe->push(T(new uint64(Ledger::Encode(w, i))));
+    }));
+  for (uint32 i = 0; i < threads.size(); ++i)
+    threads[i].join();
+  delete pipe;
+
+  bool ok = ledger.check();
+  std::cout << (ok ? "ok     " : "FAILED ") << name << " move-only batches " << writers << "x" << readers << std::endl;
+  return ok;
+}
+
+int main(int argc, char **argv) {
+
+  uint64 count = argc > 1 ? strtoull(argv[1], NULL, 10) : 100000; // items per writer
+#ifdef PIPE_1
+  std::cout << "PIPE_1" << std::endl;
+#else
+  std::cout << "PIPE_2" << std::endl;
+#endif
+  bool ok = true;
+  ok &= RunSingle<PipeNN<uint64, 100>, uint64>("PipeNN<uint64, 100>", 8, 8, count);
+  ok &= RunSingle<PipeNN<std::unique_ptr<uint64>, 37>, std::unique_ptr<uint64> >("PipeNN<unique_ptr, 37>", 8, 8, count);
+  ok &= RunSingle<PipeN1<uint64, 37>, uint64>("PipeN1<uint64, 37>", 8, 1, count);
+  ok &= RunSingle<Pipe1N<uint64, 37>, uint64>("Pipe1N<uint64, 37>", 1, 8, count);
+  ok &= RunSingle<Pipe11<std::unique_ptr<uint64>, 37>, std::unique_ptr<uint64> >("Pipe11<unique_ptr, 37>", 1, 1, count);
+  ok &= RunBatches<PipeNN<uint64, 37> >("PipeNN<uint64, 37>", 8, 8, count);
+  ok &= RunBatches<PipeNN<uint64, 1000> >("PipeNN<uint64, 1000>", 16, 16, count);
+  ok &= RunBatches<PipeN1<uint64, 37> >("PipeN1<uint64, 37>", 8, 1, count);
+  ok &= RunBatches<Pipe1N<uint64, 37> >("Pipe1N<uint64, 37>", 1, 8, count);
+  ok &= RunBatches<Pipe11<uint64, 37> >("Pipe11<uint64, 37>", 1, 1, count);
+  ok &= RunMoveBatches<PipeNN<std::unique_ptr<uint64>, 37> >("PipeNN<unique_ptr, 37>", 8, 8, count);
+  ok &= RunSingle<ShardedPipe<std::unique_ptr<uint64>, 37, 4>, std::unique_ptr<uint64> >("ShardedPipe<unique_ptr, 37, 4>", 8, 8, count);
+  ok &= RunBatches<ShardedPipe<uint64, 37, 4> >("ShardedPipe<uint64, 37, 4>", 8, 8, count);
+  ok &= RunMoveBatches<ShardedPipe<std::unique_ptr<uint64>, 37, 4> >("ShardedPipe<unique_ptr, 37, 4>", 8, 8, count);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA
+//_/_/ Autocatalytic Endogenous Reflective Architecture
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/ 
+//_/_/ Copyright (c) 2010-2012 Eric Nivel, Thor List
+//_/_/ Center for Analysis and Design of Intelligent Agents
+//_/_/ Reykjavik University, Menntavegur 1, 102 Reykjavik, Iceland
+//_/_/ http://cadia.ru.is
+//_/_/ 
+//_/_/ Part of this software was developed by Eric Nivel
+//_/_/ in the HUMANOBS EU research project, which included
+//_/_/ the following parties:
+//_/_/
+//_/_/ Autonomous Systems Laboratory
+//_/_/ Technical University of Madrid, Spain
+//_/_/ http://www.aslab.org/
+//_/_/
+//_/_/ Communicative Machines
+//_/_/ Edinburgh, United Kingdom
+//_/_/ http://www.cmlabs.com/
+//_/_/
+//_/_/ Istituto Dalle Molle di Studi sull'Intelligenza Artificiale
+//_/_/ University of Lugano and SUPSI, Switzerland
+//_/_/ http://www.idsia.ch/
+//_/_/
+//_/_/ Institute of Cognitive Sciences and Technologies
+//_/_/ Consiglio Nazionale delle Ricerche, Italy
+//_/_/ http://www.istc.cnr.it/
+//_/_/
+//_/_/ Dipartimento di Ingegneria Informatica
+//_/_/ University of Palermo, Italy
+//_/_/ http://diid.unipa.it/roboticslab/
+//_/_/
+//_/_/
+//_/_/ --- HUMANOBS Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+// Crash test of SharedPipe, Linux only: two child processes push sequenced items to the parent. The first dies in the middle of a
+// push, between taking its ticket and publishing its item: it pushes an item it cannot read (a PROT_NONE page), and the fault
+// kills it. The second pushes until killed by the parent. The parent pops with a timeout: the pop waiting on the slot of the dead
+// writer is to return false at its deadline, then, once the second writer is killed too, the parent drains the pipe and its pop is
+// to return false when the ring is empty. All the items published are to be popped, in the order of their writer.
+// A watchdog fails the test if the parent hangs.
+// Usage: shared_pipe_test [rounds]; defaults to 10. Returns 0 if all rounds pass.
+
+#include "pipe.h"
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+
+using namespace core;
+
+static const uint32 Watchdog = 10; // s per round
+static const std::chrono::milliseconds PopTimeout(500);
+
+class Item {
+public:
+  uint32 writer_;
+  uint32 sequence_;
+};
+
+typedef SharedPipe<Item, 8> ItemPipe;
+
+static void Hung(int) {
+
+  const char message[] = "> Error: the reader hung\n";
+  if (write(2, message, sizeof(message) - 1)) {}
+  _exit(1);
+}
+
+// In a child: pushes count items, then dies in the middle of a push; pushes until killed if count is 0.
+static void Write(const char *name, uint32 writer, uint32 count) {
+
+  struct rlimit noCore = { 0, 0 };
+  setrlimit(RLIMIT_CORE, &noCore);
+  ItemPipe pipe;
+  if (!pipe.open(name, ItemPipe::Writer))
+    _exit(1);
+  Item item = { writer, 0 };
+  for (; !count || item.sequence_ < count; ++item.sequence_)
+    if (!pipe.push(item))
+      _exit(0);
+  Item *unreadable = (Item *)mmap(NULL, Memory::PageSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  pipe.push(*unreadable); // faults when copying the item into its slot
+  _exit(1);
+}
+
+static bool Round(uint32 round) {
+
+  char name[64];
+  snprintf(name, sizeof(name), "/shared_pipe_test_%d", (int)getpid());
+  ItemPipe pipe;
+  if (!pipe.create(name, ItemPipe::Reader)) {
+
+    std::cerr << "> Error: cannot create " << name << std::endl;
+    return false;
+  }
+  const uint32 dying = 1 + round * 3; // items the first writer publishes
+  pid_t children[2];
+  for (uint32 w = 0; w < 2; ++w)
+    if (!(children[w] = fork()))
+      Write(name, w, w ? 0 : dying);
+
+  bool ok = true;
+  bool killed = false;
+  uint32 next[2] = { 0, 0 };
+  alarm(Watchdog);
+  for (;;) {
+
+    Item item;
+    if (!pipe.pop_for(item, PopTimeout)) {
+
+      if (killed) // drained
+        break;
+      kill(children[1], SIGKILL);
+      waitpid(children[1], NULL, 0);
+      killed = true;
+      continue;
+    }
+    if (item.writer_ > 1 || item.sequence_ != next[item.writer_]) {
+
+      std::cerr << "> Error: lost or out of order item" << std::endl;
+      ok = false;
+      break;
+    }
+    ++next[item.writer_];
+  }
+  alarm(0);
+  if (!killed) {
+
+    kill(children[1], SIGKILL);
+    waitpid(children[1], NULL, 0);
+  }
+  waitpid(children[0], NULL, 0);
+  if (ok && next[0] != dying) {
+
+    std::cerr << "> Error: " << dying - next[0] << " items of the dead writer lost" << std::endl;
+    ok = false;
+  }
+  pipe.close();
+  return ok;
+}
+
+int main(int argc, char **argv) {
+
+  uint32 rounds = argc > 1 ? atoi(argv[1]) : 10;
+  signal(SIGALRM, Hung);
+  bool ok = true;
+  for (uint32 r = 0; r < rounds && ok; ++r)
+    ok = Round(r);
+  std::cout << (ok ? "ok     " : "FAILED ") << "SharedPipe<Item, 8> writer dying in a push, " << rounds << " rounds" << std::endl;
+  return ok ? 0 : 1;
+}
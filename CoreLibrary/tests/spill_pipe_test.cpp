@@ -0,0 +1,191 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA
+//_/_/ Autocatalytic Endogenous Reflective Architecture
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/ 
+//_/_/ Copyright (c) 2010-2012 Eric Nivel, Thor List
+//_/_/ Center for Analysis and Design of Intelligent Agents
+//_/_/ Reykjavik University, Menntavegur 1, 102 Reykjavik, Iceland
+//_/_/ http://cadia.ru.is
+//_/_/ 
+//_/_/ Part of this software was developed by Eric Nivel
+//_/_/ in the HUMANOBS EU research project, which included
+//_/_/ the following parties:
+//_/_/
+//_/_/ Autonomous Systems Laboratory
+//_/_/ Technical University of Madrid, Spain
+//_/_/ http://www.aslab.org/
+//_/_/
+//_/_/ Communicative Machines
+//_/_/ Edinburgh, United Kingdom
+//_/_/ http://www.cmlabs.com/
+//_/_/
+//_/_/ Istituto Dalle Molle di Studi sull'Intelligenza Artificiale
+//_/_/ University of Lugano and SUPSI, Switzerland
+//_/_/ http://www.idsia.ch/
+//_/_/
+//_/_/ Institute of Cognitive Sciences and Technologies
+//_/_/ Consiglio Nazionale delle Ricerche, Italy
+//_/_/ http://www.istc.cnr.it/
+//_/_/
+//_/_/ Dipartimento di Ingegneria Informatica
+//_/_/ University of Palermo, Italy
+//_/_/ http://diid.unipa.it/roboticslab/
+//_/_/
+//_/_/
+//_/_/ --- HUMANOBS Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+// Test of SpillPipe when its file fails, Linux only: mmap and pread are stubbed to fail on demand. Items are pushed past the
+// watermark, then popped by concurrent readers. When mapping the file fails, the chunks are to be read instead and no item is
+// lost; when reading fails too, the chunks of the file are lost, and exactly the items left are to be popped, the pipe holding
+// none afterwards. A watchdog fails the test if a reader hangs.
+// Usage: spill_pipe_test. Returns 0 if all cases pass.
+
+#include "pipe.h"
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+
+using namespace core;
+
+static const uint32 Watchdog = 10; // s per case
+static const uint32 Items = 1000;
+static const uint32 Watermark = 100;
+static const uint32 Readers = 4;
+
+typedef SpillPipe<uint32, 64> ItemPipe;
+
+static bool FailMap = false;
+static bool FailRead = false;
+
+extern "C" void *mmap(void *address, size_t length, int prot, int flags, int fd, off_t offset) __THROW {
+
+  if (FailMap && fd >= 0) {
+
+    errno = ENOMEM;
+    return MAP_FAILED;
+  }
+  return (void *)syscall(SYS_mmap, address, length, prot, flags, fd, offset);
+}
+
+extern "C" ssize_t pread(int fd, void *buffer, size_t count, off_t offset) {
+
+  if (FailRead) {
+
+    errno = EIO;
+    return -1;
+  }
+  return syscall(SYS_pread64, fd, buffer, count, offset);
+}
+
+static void Hung(int) {
+
+  const char message[] = "> Error: a reader hung\n";
+  if (write(2, message, sizeof(message) - 1)) {}
+  _exit(1);
+}
+
+static bool Case(const char *name, bool failRead) {
+
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/spill_pipe_test_%d", (int)getpid());
+  ItemPipe pipe(path, Watermark);
+  for (uint32 i = 0; i < Items; ++i)
+    pipe.push(i);
+  FailMap = true;
+  FailRead = failRead;
+
+  const uint32 lost = failRead ? (Items - Watermark) / 64 * 64 : 0; // the chunks in the file; the tail is in memory
+  std::atomic_int32_t left(Items - lost);
+  std::vector<uint8> seen(Items, 0);
+  std::thread readers[Readers];
+  alarm(Watchdog);
+  for (uint32 r = 0; r < Readers; ++r)
+    readers[r] = std::thread([&]() {
+
+      while (left.fetch_sub(1) > 0)
+        ++seen[pipe.pop()]; // distinct items: no race on seen
+    });
+  for (uint32 r = 0; r < Readers; ++r)
+    readers[r].join();
+  alarm(0);
+
+  bool ok = true;
+  uint32 popped = 0;
+  for (uint32 i = 0; i < Items; ++i) {
+
+    if (seen[i] > 1)
+      ok = false;
+    popped += seen[i];
+  }
+  uint32 extra;
+  if (pipe.try_pop(extra))
+    ok = false;
+  if (pipe.lost() != lost)
+    ok = false;
+  FailMap = FailRead = false;
+  pipe.push(Items); // the pipe works again
+  if (!pipe.try_pop(extra) || extra != Items)
+    ok = false;
+  if (!ok)
+    std::cerr << "> Error: " << popped << " items popped, " << pipe.lost() << " lost, instead of " << Items - lost << " and " << lost << std::endl;
+  std::cout << (ok ? "ok     " : "FAILED ") << "SpillPipe<uint32, 64> " << name << std::endl;
+  return ok;
+}
+
+int main() {
+
+  signal(SIGALRM, Hung);
+  bool ok = Case("mapping failing", false);
+  ok = Case("mapping and reading failing", true) && ok;
+  return ok ? 0 : 1;
+}
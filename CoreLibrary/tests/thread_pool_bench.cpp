@@ -0,0 +1,244 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA
+//_/_/ Autocatalytic Endogenous Reflective Architecture
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/ 
+//_/_/ Copyright (c) 2010-2012 Eric Nivel, Thor List
+//_/_/ Center for Analysis and Design of Intelligent Agents
+//_/_/ Reykjavik University, Menntavegur 1, 102 Reykjavik, Iceland
+//_/_/ http://cadia.ru.is
+//_/_/ 
+//_/_/ Part of this software was developed by Eric Nivel
+//_/_/ in the HUMANOBS EU research project, which included
+//_/_/ the following parties:
+//_/_/
+//_/_/ Autonomous Systems Laboratory
+//_/_/ Technical University of Madrid, Spain
+//_/_/ http://www.aslab.org/
+//_/_/
+//_/_/ Communicative Machines
+//_/_/ Edinburgh, United Kingdom
+//_/_/ http://www.cmlabs.com/
+//_/_/
+//_/_/ Istituto Dalle Molle di Studi sull'Intelligenza Artificiale
+//_/_/ University of Lugano and SUPSI, Switzerland
+//_/_/ http://www.idsia.ch/
+//_/_/
+//_/_/ Institute of Cognitive Sciences and Technologies
+//_/_/ Consiglio Nazionale delle Ricerche, Italy
+//_/_/ http://www.istc.cnr.it/
+//_/_/
+//_/_/ Dipartimento di Ingegneria Informatica
+//_/_/ University of Palermo, Italy
+//_/_/ http://diid.unipa.it/roboticslab/
+//_/_/
+//_/_/
+//_/_/ --- HUMANOBS Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+// Scaling of the ThreadPool against the PipeNN worker pattern (of the engine selected at compile time: build with -DPIPE_1 or
+// -DPIPE_2), where workers pop callables from one shared PipeNN, from 1 worker up to one per core, doubling:
+// - flat: the main thread submits Tasks tasks of Work units of work each, with no work at all, then a little;
+// - nested: each task of a binary tree of Depth levels submits its two children from its worker, and the leaves do the work.
+// Each figure is the best of Runs runs, in thousands of tasks per second.
+// Usage: thread_pool_bench [max workers]; defaults to the number of cores.
+
+#include "pipe.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <functional>
+
+
+using namespace core;
+
+static const uint32 Runs = 3;
+static const uint32 Tasks = 200000;
+static const uint32 Depth = 17; // 2^17 leaves
+static const uint32 Work = 1000; // spins of a loaded task
+
+#ifdef PIPE_1
+static const char *Engine = "PIPE_1";
+#else
+static const char *Engine = "PIPE_2";
+#endif
+
+static void Spin(uint32 work) {
+
+  uint64 x = work;
+  for (uint32 i = 0; i < work; ++i)
+    x = x * 6364136223846793005ull + 1442695040888963407ull;
+  __asm__ __volatile__("" : : "r"(x)); // keeps the loop
+}
+
+static void Wait(std::atomic<uint64> &done, uint64 count) {
+
+  while (done.load(std::memory_order_acquire) < count)
+    std::this_thread::yield();
+}
+
+// The pattern: workers pop and run callables until they pop an empty one.
+class PipeWorkers {
+private:
+  std::vector<std::thread> threads_;
+public:
+  PipeNN<std::function<void()>, 1024> jobs_;
+  PipeWorkers(uint32 workers) {
+
+    for (uint32 i = 0; i < workers; ++i)
+      threads_.push_back(std::thread([this]() {
+
+        for (;;) {
+
+          std::function<void()> job = jobs_.pop();
+          if (!job)
+            break;
+          job();
+        }
+      }));
+  }
+  ~PipeWorkers() {
+
+    for (uint32 i = 0; i < threads_.size(); ++i)
+      jobs_.push(std::function<void()>());
+    for (uint32 i = 0; i < threads_.size(); ++i)
+      threads_[i].join();
+  }
+  void submit(std::function<void()> f) { jobs_.push(std::move(f)); }
+};
+
+class PoolWorkers {
+public:
+  ThreadPool pool_;
+  PoolWorkers(uint32 workers) : pool_(workers) {}
+  template<class F> void submit(F &&f) { pool_.submit(std::forward<F>(f)); }
+};
+
+template<class W> class Tree {
+public:
+  W &workers_;
+  std::atomic<uint64> &done_;
+  void operator ()(uint32 depth) const {
+
+    if (!depth) {
+
+      Spin(Work);
+      done_.fetch_add(1, std::memory_order_release);
+      return;
+    }
+    const Tree *self = this;
+    workers_.submit([self, depth]() { (*self)(depth - 1); });
+    workers_.submit([self, depth]() { (*self)(depth - 1); });
+  }
+};
+
+template<class W> double Flat(uint32 workers, uint32 work) { // thousands of tasks per second
+
+  W w(workers);
+  std::atomic<uint64> done(0);
+  std::atomic<uint64> *d = &done;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32 i = 0; i < Tasks; ++i)
+    w.submit([d, work]() {
+
+      Spin(work);
+      d->fetch_add(1, std::memory_order_release);
+    });
+  Wait(done, Tasks);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return Tasks / seconds / 1e3;
+}
+
+template<class W> double Nested(uint32 workers) {
+
+  W w(workers);
+  std::atomic<uint64> done(0);
+  Tree<W> tree = { w, done };
+  const uint64 leaves = 1ull << Depth;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  w.submit([&tree]() { tree(Depth); });
+  Wait(done, leaves);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return (2 * leaves - 1) / seconds / 1e3;
+}
+
+template<class W> double Best(uint32 workers, int32 work) { // work < 0 for the nested tree
+
+  double best = 0;
+  for (uint32 i = 0; i < Runs; ++i) {
+
+    double rate = work < 0 ? Nested<W>(workers) : Flat<W>(workers, work);
+    if (rate > best)
+      best = rate;
+  }
+  return best;
+}
+
+void Bench(const char *name, uint32 workers, int32 work) {
+
+  double pool = Best<PoolWorkers>(workers, work);
+  double pipe = Best<PipeWorkers>(workers, work);
+  printf("%s %-12s %2u workers: ThreadPool %8.1f, PipeNN workers %8.1f Ktasks/s (x%.2f)\n", Engine, name, workers, pool, pipe, pool / pipe);
+}
+
+int main(int argc, char **argv) {
+
+  uint32 cores = argc > 1 ? atoi(argv[1]) : std::thread::hardware_concurrency();
+  if (!cores)
+    cores = 1;
+  for (uint32 w = 1;; w = w * 2 < cores ? w * 2 : cores) {
+
+    Bench("flat, empty", w, 0);
+    Bench("flat, loaded", w, Work);
+    Bench("nested", w, -1);
+    if (w == cores)
+      break;
+  }
+  return 0;
+}
@@ -0,0 +1,431 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA
+//_/_/ Autocatalytic Endogenous Reflective Architecture
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/ 
+//_/_/ Copyright (c) 2010-2012 Eric Nivel, Thor List
+//_/_/ Center for Analysis and Design of Intelligent Agents
+//_/_/ Reykjavik University, Menntavegur 1, 102 Reykjavik, Iceland
+//_/_/ http://cadia.ru.is
+//_/_/ 
+//_/_/ Part of this software was developed by Eric Nivel
+//_/_/ in the HUMANOBS EU research project, which included
+//_/_/ the following parties:
+//_/_/
+//_/_/ Autonomous Systems Laboratory
+//_/_/ Technical University of Madrid, Spain
+//_/_/ http://www.aslab.org/
+//_/_/
+//_/_/ Communicative Machines
+//_/_/ Edinburgh, United Kingdom
+//_/_/ http://www.cmlabs.com/
+//_/_/
+//_/_/ Istituto Dalle Molle di Studi sull'Intelligenza Artificiale
+//_/_/ University of Lugano and SUPSI, Switzerland
+//_/_/ http://www.idsia.ch/
+//_/_/
+//_/_/ Institute of Cognitive Sciences and Technologies
+//_/_/ Consiglio Nazionale delle Ricerche, Italy
+//_/_/ http://www.istc.cnr.it/
+//_/_/
+//_/_/ Dipartimento di Ingegneria Informatica
+//_/_/ University of Palermo, Italy
+//_/_/ http://diid.unipa.it/roboticslab/
+//_/_/
+//_/_/
+//_/_/ --- HUMANOBS Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+#include "thread_pool.h"
+
+
+namespace core {
+
+ThreadPool::Deque::Array::Array(int64 size) : size_(size) {
+
+  slots_ = new std::atomic<Task *>[size];
+}
+
+ThreadPool::Deque::Array::~Array() {
+
+  delete[] slots_;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+ThreadPool::Deque::Deque() : top_(0), bottom_(0), array_(new Array(1024)) {
+}
+
+ThreadPool::Deque::~Deque() {
+
+  delete array_.load();
+  for (uint32 i = 0; i < retired_.size(); ++i)
+    delete retired_[i];
+}
+
+void ThreadPool::Deque::push(Task *t) {
+
+  int64 b = bottom_.load(std::memory_order_relaxed);
+  int64 top = top_.load(std::memory_order_acquire);
+  Array *a = array_.load(std::memory_order_relaxed);
+  if (b - top > a->size_ - 1) { // full
+
+    Array *bigger = new Array(a->size_ * 2);
+    for (int64 i = top; i < b; ++i)
+      bigger->put(i, a->get(i));
+    retired_.push_back(a);
+    array_.store(bigger, std::memory_order_release);
+    a = bigger;
+  }
+  a->put(b, t);
+  bottom_.store(b + 1, std::memory_order_release);
+}
+
+ThreadPool::Task *ThreadPool::Deque::pop() {
+
+  int64 b = bottom_.load(std::memory_order_relaxed) - 1;
+  Array *a = array_.load(std::memory_order_relaxed);
+  bottom_.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst); // thieves see the bottom taken before we read the top
+  int64 top = top_.load(std::memory_order_relaxed);
+  if (top > b) { // empty
+
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return NULL;
+  }
+  Task *t = a->get(b);
+  if (top == b) { // the last one: thieves may be after it too
+
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+      t = NULL;
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+  return t;
+}
+
+ThreadPool::Task *ThreadPool::Deque::steal() {
+
+  int64 top = top_.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64 b = bottom_.load(std::memory_order_acquire);
+  if (top >= b)
+    return NULL;
+  Task *t = array_.load(std::memory_order_acquire)->get(top);
+  if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    return NULL;
+  return t;
+}
+
+bool ThreadPool::Deque::empty() const {
+
+  return top_.load() >= bottom_.load();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+ThreadPool::Worker::Worker(ThreadPool *pool, uint32 index) : pool_(pool), index_(index), free_(NULL), returned_(NULL), seed_(index * 2654435761u + 1) {
+}
+
+ThreadPool::Worker::~Worker() {
+
+  for (uint32 i = 0; i < chunks_.size(); ++i)
+    delete[] chunks_[i];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+ThreadPool::ThreadPool(uint32 workers) : submittedFirst_(NULL), submittedLast_(NULL), submitted_(0), externalFree_(NULL), parked_(0), wake_(0), stop_(false) {
+
+  if (!workers)
+    workers = std::thread::hardware_concurrency();
+  if (!workers)
+    workers = 1;
+  for (uint32 i = 0; i < workers; ++i)
+    workers_.push_back(new (Memory::AlignedAllocate(sizeof(Worker))) Worker(this, i)); // plain new may not honor the alignment of Worker
+  for (uint32 i = 0; i < workers; ++i)
+    threads_.push_back(Thread::New<Thread>(Work, workers_[i]));
+}
+
+ThreadPool::~ThreadPool() {
+
+  stop_.store(true);
+  wake_.release(workers_.size());
+  Thread::Wait(&threads_[0], threads_.size());
+  for (uint32 i = 0; i < threads_.size(); ++i)
+    delete threads_[i];
+  for (uint32 i = 0; i < workers_.size(); ++i) {
+
+    workers_[i]->~Worker();
+    Memory::AlignedFree(workers_[i]);
+  }
+  for (uint32 i = 0; i < externalChunks_.size(); ++i)
+    delete[] externalChunks_[i];
+}
+
+ThreadPool &ThreadPool::Default() {
+
+  static ThreadPool Pool;
+  return Pool;
+}
+
+ThreadPool::Worker *&ThreadPool::Current() {
+
+  static thread_local Worker *Current = NULL;
+  return Current;
+}
+
+thread_ret thread_function_call ThreadPool::Work(void *args) {
+
+  Worker *w = (Worker *)args;
+  ThreadPool *pool = w->pool_;
+  Current() = w;
+  for (;;) {
+
+    Task *t = pool->find(w);
+    if (t) {
+
+      pool->run(t);
+      continue;
+    }
+    if (pool->stop_.load() && pool->idle())
+      break;
+    pool->park();
+  }
+  Current() = NULL;
+  thread_ret_val(0);
+}
+
+ThreadPool::Task *ThreadPool::NewChunk(std::vector<Task *> &chunks, uint32 owner) {
+
+  Task *chunk = new Task[ChunkSize];
+  for (uint32 i = 0; i < ChunkSize; ++i) {
+
+    chunk[i].owner_ = owner;
+    chunk[i].next_ = i + 1 < ChunkSize ? chunk + i + 1 : NULL;
+  }
+  chunks.push_back(chunk);
+  return chunk;
+}
+
+ThreadPool::Task *ThreadPool::allocate() {
+
+  Task *t;
+  Worker *w = Current();
+  if (w && w->pool_ == this) {
+
+    if (!w->free_)
+      w->free_ = w->returned_.exchange(NULL, std::memory_order_acquire);
+    if (!w->free_)
+      w->free_ = NewChunk(w->chunks_, w->index_);
+    t = w->free_;
+    w->free_ = t->next_;
+    return t;
+  }
+  externalCS_.enter();
+  if (!externalFree_)
+    externalFree_ = NewChunk(externalChunks_, External);
+  t = externalFree_;
+  externalFree_ = t->next_;
+  externalCS_.leave();
+  return t;
+}
+
+void ThreadPool::recycle(Task *t) {
+
+  if (t->owner_ == External) {
+
+    externalCS_.enter();
+    t->next_ = externalFree_;
+    externalFree_ = t;
+    externalCS_.leave();
+    return;
+  }
+  Worker *w = Current();
+  if (w && w->pool_ == this && w->index_ == t->owner_) {
+
+    t->next_ = w->free_;
+    w->free_ = t;
+    return;
+  }
+  Worker *owner = workers_[t->owner_]; // the owner takes all the returned tasks at once: no ABA
+  Task *head = owner->returned_.load(std::memory_order_relaxed);
+  do
+    t->next_ = head;
+  while (!owner->returned_.compare_exchange_weak(head, t, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void ThreadPool::push(Task *t) {
+
+  Worker *w = Current();
+  if (w && w->pool_ == this)
+    w->deque_.push(t);
+  else {
+
+    t->next_ = NULL;
+    submittedCS_.enter();
+    if (submittedLast_)
+      submittedLast_->next_ = t;
+    else
+      submittedFirst_ = t;
+    submittedLast_ = t;
+    submitted_.fetch_add(1, std::memory_order_relaxed);
+    submittedCS_.leave();
+  }
+  std::atomic_thread_fence(std::memory_order_seq_cst); // parking workers see the task, or we see them
+  int32 parked = parked_.load(std::memory_order_relaxed);
+  while (parked > 0)
+    if (parked_.compare_exchange_weak(parked, parked - 1)) {
+
+      wake_.release();
+      break;
+    }
+}
+
+ThreadPool::Task *ThreadPool::takeSubmitted() {
+
+  if (submitted_.load(std::memory_order_relaxed) <= 0) // saves the lock when none is waiting
+    return NULL;
+  submittedCS_.enter();
+  Task *t = submittedFirst_;
+  if (t) {
+
+    submittedFirst_ = t->next_;
+    if (!submittedFirst_)
+      submittedLast_ = NULL;
+    submitted_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  submittedCS_.leave();
+  return t;
+}
+
+ThreadPool::Task *ThreadPool::find(Worker *w) {
+
+  static thread_local uint32 Seed = Thread::Index() * 2654435761u + 1; // for threads other than the workers
+  Task *t = w ? w->deque_.pop() : NULL;
+  if (t || (t = takeSubmitted()))
+    return t;
+  uint32 &seed = w ? w->seed_ : Seed;
+  uint32 n = (uint32)workers_.size();
+  for (uint32 attempt = 0; attempt < 2 * n; ++attempt) {
+
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    Worker *victim = workers_[seed % n];
+    if (victim != w && (t = victim->deque_.steal()))
+      return t;
+  }
+  return NULL;
+}
+
+bool ThreadPool::idle() const {
+
+  if (submitted_.load() > 0)
+    return false;
+  for (uint32 i = 0; i < workers_.size(); ++i)
+    if (!workers_[i]->deque_.empty())
+      return false;
+  return true;
+}
+
+void ThreadPool::park() {
+
+  parked_.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (idle() && !stop_.load()) {
+
+    wake_.acquire();
+    return;
+  }
+  int32 parked = parked_.load(std::memory_order_relaxed); // work came meanwhile: unpark, unless a submission did it for us
+  while (parked > 0)
+    if (parked_.compare_exchange_weak(parked, parked - 1))
+      return;
+  wake_.acquire(); // the release of that submission
+}
+
+void ThreadPool::run(Task *t) {
+
+  t->run_(t);
+  recycle(t);
+}
+
+bool ThreadPool::runOne() {
+
+  Worker *w = Current();
+  Task *t = find(w && w->pool_ == this ? w : NULL);
+  if (!t)
+    return false;
+  run(t);
+  return true;
+}
+
+int32 ThreadPool::current() const {
+
+  Worker *w = Current();
+  return w && w->pool_ == this ? (int32)w->index_ : -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+TaskGroup::TaskGroup(ThreadPool &pool) : pool_(pool), pending_(0) {
+}
+
+TaskGroup::~TaskGroup() {
+
+  wait();
+}
+
+void TaskGroup::wait() {
+
+  while (pending_.load(std::memory_order_acquire) > 0)
+    if (!pool_.runOne()) // the tasks left are running elsewhere
+      std::this_thread::yield();
+}
+}
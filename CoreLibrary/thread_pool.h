@@ -0,0 +1,237 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA
+//_/_/ Autocatalytic Endogenous Reflective Architecture
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/ 
+//_/_/ Copyright (c) 2010-2012 Eric Nivel, Thor List
+//_/_/ Center for Analysis and Design of Intelligent Agents
+//_/_/ Reykjavik University, Menntavegur 1, 102 Reykjavik, Iceland
+//_/_/ http://cadia.ru.is
+//_/_/ 
+//_/_/ Part of this software was developed by Eric Nivel
+//_/_/ in the HUMANOBS EU research project, which included
+//_/_/ the following parties:
+//_/_/
+//_/_/ Autonomous Systems Laboratory
+//_/_/ Technical University of Madrid, Spain
+//_/_/ http://www.aslab.org/
+//_/_/
+//_/_/ Communicative Machines
+//_/_/ Edinburgh, United Kingdom
+//_/_/ http://www.cmlabs.com/
+//_/_/
+//_/_/ Istituto Dalle Molle di Studi sull'Intelligenza Artificiale
+//_/_/ University of Lugano and SUPSI, Switzerland
+//_/_/ http://www.idsia.ch/
+//_/_/
+//_/_/ Institute of Cognitive Sciences and Technologies
+//_/_/ Consiglio Nazionale delle Ricerche, Italy
+//_/_/ http://www.istc.cnr.it/
+//_/_/
+//_/_/ Dipartimento di Ingegneria Informatica
+//_/_/ University of Palermo, Italy
+//_/_/ http://diid.unipa.it/roboticslab/
+//_/_/
+//_/_/
+//_/_/ --- HUMANOBS Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+#ifndef core_thread_pool_h
+#define core_thread_pool_h
+
+#include "utils.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+
+namespace core {
+
+// A ThreadPool runs tasks (callables taking no argument) on a fixed set of worker threads.
+// Each worker has its own Chase-Lev deque: a task submitted by a worker goes to the bottom of the worker's deque, where the worker
+// takes it back from (LIFO, cache friendly), while idle workers steal from the top of the deque of a random victim (FIFO).
+// Tasks submitted by other threads go to a shared FIFO that the workers drain when their deque is empty: a plain list under a
+// critical section, independent of the pipe engine selected in pipe.h, so that the layout of the class does not depend on it.
+// Workers with nothing to run or steal park on a lightweight semaphore; a submission wakes one only when some are parked.
+// The storage of a task is recycled: submit() never allocates for a callable of up to Task::InlineBytes, once warmed up.
+class core_dll ThreadPool {
+public:
+  class Task {
+    friend class ThreadPool;
+  public:
+    static const uint32 InlineBytes = 48;
+  private:
+    typedef void (*Run)(Task *t);
+    Run run_; // runs and destroys the callable
+    Task *next_; // in a free list, or in the submitted tasks
+    uint32 owner_; // the worker whose free list it belongs to
+    std::aligned_storage<InlineBytes, alignof(std::max_align_t)>::type callable_; // or a pointer to it if too large
+    template<class F> static void RunInline(Task *t);
+    template<class F> static void RunAllocated(Task *t);
+    template<class F> void set(F &&f);
+  };
+private:
+  static const uint32 External = 0xFFFFFFFF; // owner of the tasks submitted by other threads
+  static const uint32 ChunkSize = 64; // tasks allocated at once for a free list
+
+  class Deque { // Chase-Lev, as formulated by Le et al. for weak memory models
+  private:
+    class Array {
+    public:
+      const int64 size_; // a power of 2
+      std::atomic<Task *> *slots_;
+      Array(int64 size);
+      ~Array();
+      Task *get(int64 i) const { return slots_[i & (size_ - 1)].load(std::memory_order_relaxed); }
+      void put(int64 i, Task *t) { slots_[i & (size_ - 1)].store(t, std::memory_order_relaxed); }
+    };
+    alignas(Memory::CacheLineSize) std::atomic<int64> top_; // thieves take from here
+    alignas(Memory::CacheLineSize) std::atomic<int64> bottom_; // the owner pushes and takes from here
+    std::atomic<Array *> array_;
+    std::vector<Array *> retired_; // outgrown arrays, which thieves may still be reading
+  public:
+    Deque();
+    ~Deque();
+    void push(Task *t); // by the owner
+    Task *pop(); // by the owner; NULL if empty
+    Task *steal(); // by the others; NULL if empty, or if another thief won the race
+    bool empty() const;
+  };
+
+  class alignas(Memory::CacheLineSize) Worker {
+  public:
+    ThreadPool *pool_;
+    uint32 index_;
+    Deque deque_;
+    Task *free_; // owned by the worker
+    std::atomic<Task *> returned_; // tasks of the worker's free list run by other threads
+    std::vector<Task *> chunks_;
+    uint32 seed_; // for the choice of victims
+    Worker(ThreadPool *pool, uint32 index);
+    ~Worker();
+  };
+
+  std::vector<Worker *> workers_; // aligned on a cache line (see Memory::AlignedAllocate)
+  std::vector<Thread *> threads_;
+  Task *submittedFirst_; // by other threads, linked in order
+  Task *submittedLast_;
+  CriticalSection submittedCS_; // guards the above two
+  std::atomic_int32_t submitted_; // count, read without submittedCS_
+  Task *externalFree_;
+  std::vector<Task *> externalChunks_;
+  CriticalSection externalCS_; // guards the above two
+  alignas(Memory::CacheLineSize) std::atomic_int32_t parked_; // workers about to sleep or sleeping, minus those a submission has woken
+  LightweightSemaphore wake_;
+  std::atomic_bool stop_;
+
+  static thread_ret thread_function_call Work(void *args);
+  static Worker *&Current(); // the worker running on the calling thread, if any
+  static Task *NewChunk(std::vector<Task *> &chunks, uint32 owner);
+  Task *allocate();
+  void recycle(Task *t);
+  void push(Task *t);
+  Task *takeSubmitted(); // NULL if none
+  Task *find(Worker *w); // a task to run, from the worker's deque, the submitted ones, or a victim's deque
+  bool idle() const; // no task is waiting anywhere
+  void park(); // by a worker having found nothing to run
+  void run(Task *t);
+public:
+  ThreadPool(uint32 workers = 0); // 0: one per core
+  ~ThreadPool(); // runs the tasks submitted, then stops the workers
+  static ThreadPool &Default(); // one worker per core, created on first use
+  template<class F> void submit(F &&f);
+  bool runOne(); // runs a waiting task on the calling thread, if any; returns false if none was found
+  uint32 workers() const { return (uint32)workers_.size(); }
+  int32 current() const; // index of the worker running on the calling thread; -1 if not a worker of this pool
+};
+
+// Tasks to wait for together: wait() runs the tasks of the pool (of this group or not) until those of the group are done,
+// which lets a task wait for the tasks it has forked without blocking its worker.
+class core_dll TaskGroup {
+private:
+  template<class F> class Call {
+  public:
+    TaskGroup *group_;
+    F f_;
+    void operator ()() { f_(); group_->pending_.fetch_sub(1, std::memory_order_release); }
+  };
+  ThreadPool &pool_;
+  std::atomic_int32_t pending_;
+public:
+  TaskGroup(ThreadPool &pool = ThreadPool::Default());
+  ~TaskGroup(); // waits
+  template<class F> void run(F &&f);
+  void wait();
+};
+
+// The loops below split their range in halves recursively, down to grain, and fork one half as a task of the pool at each step:
+// idle workers steal the largest pieces left, which balances irregular work. The calling thread takes part until the loop is done.
+
+// Calls fn(i) for i in [begin, end).
+template<typename I, class F> void parallel_for(I begin, I end, I grain, const F &fn, ThreadPool &pool = ThreadPool::Default());
+
+// Returns reduce(...reduce(reduce(identity, map(i0)), map(i1))..., map(in)) for i in [begin, end), in some order of combination:
+// reduce is associative and identity is neutral.
+template<typename I, typename T, class M, class R> T parallel_reduce(I begin, I end, I grain, const T &identity, const M &map, const R &reduce, ThreadPool &pool = ThreadPool::Default());
+
+// Sorts [begin, end) with comp (not stable): quicksort whose partitions are sorted in parallel, and by std::sort below grain items.
+template<class It, class Compare> void parallel_sort(It begin, It end, const Compare &comp, size_t grain = 2048, ThreadPool &pool = ThreadPool::Default());
+template<class It> void parallel_sort(It begin, It end, size_t grain = 2048, ThreadPool &pool = ThreadPool::Default());
+}
+
+
+#include "thread_pool.tpl.cpp"
+
+
+#endif
@@ -0,0 +1,238 @@
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+//_/_/
+//_/_/ AERA
+//_/_/ Autocatalytic Endogenous Reflective Architecture
+//_/_/ 
+//_/_/ Copyright (c) 2018-2025 Jeff Thompson
+//_/_/ Copyright (c) 2018-2025 Kristinn R. Thorisson
+//_/_/ Copyright (c) 2018-2025 Icelandic Institute for Intelligent Machines
+//_/_/ http://www.iiim.is
+//_/_/ 
+//_/_/ Copyright (c) 2010-2012 Eric Nivel, Thor List
+//_/_/ Center for Analysis and Design of Intelligent Agents
+//_/_/ Reykjavik University, Menntavegur 1, 102 Reykjavik, Iceland
+//_/_/ http://cadia.ru.is
+//_/_/ 
+//_/_/ Part of this software was developed by Eric Nivel
+//_/_/ in the HUMANOBS EU research project, which included
+//_/_/ the following parties:
+//_/_/
+//_/_/ Autonomous Systems Laboratory
+//_/_/ Technical University of Madrid, Spain
+//_/_/ http://www.aslab.org/
+//_/_/
+//_/_/ Communicative Machines
+//_/_/ Edinburgh, United Kingdom
+//_/_/ http://www.cmlabs.com/
+//_/_/
+//_/_/ Istituto Dalle Molle di Studi sull'Intelligenza Artificiale
+//_/_/ University of Lugano and SUPSI, Switzerland
+//_/_/ http://www.idsia.ch/
+//_/_/
+//_/_/ Institute of Cognitive Sciences and Technologies
+//_/_/ Consiglio Nazionale delle Ricerche, Italy
+//_/_/ http://www.istc.cnr.it/
+//_/_/
+//_/_/ Dipartimento di Ingegneria Informatica
+//_/_/ University of Palermo, Italy
+//_/_/ http://diid.unipa.it/roboticslab/
+//_/_/
+//_/_/
+//_/_/ --- HUMANOBS Open-Source BSD License, with CADIA Clause v 1.0 ---
+//_/_/
+//_/_/ Redistribution and use in source and binary forms, with or without
+//_/_/ modification, is permitted provided that the following conditions
+//_/_/ are met:
+//_/_/ - Redistributions of source code must retain the above copyright
+//_/_/   and collaboration notice, this list of conditions and the
+//_/_/   following disclaimer.
+//_/_/ - Redistributions in binary form must reproduce the above copyright
+//_/_/   notice, this list of conditions and the following disclaimer 
+//_/_/   in the documentation and/or other materials provided with 
+//_/_/   the distribution.
+//_/_/
+//_/_/ - Neither the name of its copyright holders nor the names of its
+//_/_/   contributors may be used to endorse or promote products
+//_/_/   derived from this software without specific prior 
+//_/_/   written permission.
+//_/_/   
+//_/_/ - CADIA Clause: The license granted in and to the software 
+//_/_/   under this agreement is a limited-use license. 
+//_/_/   The software may not be used in furtherance of:
+//_/_/    (i)   intentionally causing bodily injury or severe emotional 
+//_/_/          distress to any person;
+//_/_/    (ii)  invading the personal privacy or violating the human 
+//_/_/          rights of any person; or
+//_/_/    (iii) committing or preparing for any act of war.
+//_/_/
+//_/_/ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+//_/_/ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+//_/_/ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+//_/_/ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+//_/_/ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+//_/_/ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//_/_/ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+//_/_/ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+//_/_/ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//_/_/ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+//_/_/ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+//_/_/ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//_/_/ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+//_/_/ OF SUCH DAMAGE.
+//_/_/ 
+//_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+
+namespace core {
+
+template<class F> void ThreadPool::Task::RunInline(Task *t) {
+
+  F *f = reinterpret_cast<F *>(&t->callable_);
+  (*f)();
+  f->~F();
+}
+
+template<class F> void ThreadPool::Task::RunAllocated(Task *t) {
+
+  F *f = *reinterpret_cast<F **>(&t->callable_);
+  (*f)();
+  delete f;
+}
+
+template<class F> inline void ThreadPool::Task::set(F &&f) {
+
+  typedef typename std::decay<F>::type C;
+  if (sizeof(C) <= InlineBytes && alignof(C) <= alignof(std::max_align_t)) {
+
+    new (&callable_) C(std::forward<F>(f));
+    run_ = &RunInline<C>;
+  } else {
+
+    *reinterpret_cast<C **>(&callable_) = new C(std::forward<F>(f));
+    run_ = &RunAllocated<C>;
+  }
+}
+
+template<class F> inline void ThreadPool::submit(F &&f) {
+
+  Task *t = allocate();
+  t->set(std::forward<F>(f));
+  push(t);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<class F> inline void TaskGroup::run(F &&f) {
+
+  pending_.fetch_add(1, std::memory_order_relaxed);
+  Call<typename std::decay<F>::type> call = { this, std::forward<F>(f) };
+  pool_.submit(std::move(call));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename I, class F> class ParallelFor {
+public:
+  ThreadPool &pool_;
+  const I grain_;
+  const F &fn_;
+  void operator ()(I begin, I end) const {
+
+    TaskGroup group(pool_);
+    while (end - begin > grain_) {
+
+      I middle = begin + (end - begin) / 2;
+      const ParallelFor *self = this;
+      group.run([self, middle, end] { (*self)(middle, end); });
+      end = middle;
+    }
+    for (I i = begin; i < end; ++i)
+      fn_(i);
+    group.wait();
+  }
+};
+
+template<typename I, class F> void parallel_for(I begin, I end, I grain, const F &fn, ThreadPool &pool) {
+
+  if (grain < 1)
+    grain = 1;
+  ParallelFor<I, F> loop = { pool, grain, fn };
+  loop(begin, end);
+}
+
+template<typename I, typename T, class M, class R> class ParallelReduce {
+public:
+  ThreadPool &pool_;
+  const I grain_;
+  const T &identity_;
+  const M &map_;
+  const R &reduce_;
+  T operator ()(I begin, I end) const {
+
+    if (end - begin <= grain_) {
+
+      T value = identity_;
+      for (I i = begin; i < end; ++i)
+        value = reduce_(value, map_(i));
+      return value;
+    }
+    I middle = begin + (end - begin) / 2;
+    T right = identity_;
+    T *r = &right;
+    const ParallelReduce *self = this;
+    TaskGroup group(pool_);
+    group.run([self, middle, end, r] { *r = (*self)(middle, end); });
+    T left = (*this)(begin, middle);
+    group.wait();
+    return reduce_(left, right);
+  }
+};
+
+template<typename I, typename T, class M, class R> T parallel_reduce(I begin, I end, I grain, const T &identity, const M &map, const R &reduce, ThreadPool &pool) {
+
+  if (grain < 1)
+    grain = 1;
+  ParallelReduce<I, T, M, R> loop = { pool, grain, identity, map, reduce };
+  return loop(begin, end);
+}
+
+template<class It, class Compare> class ParallelSort {
+public:
+  typedef typename std::iterator_traits<It>::value_type T;
+  ThreadPool &pool_;
+  const size_t grain_;
+  const Compare &comp_;
+  const T &median(const T &a, const T &b, const T &c) const {
+
+    if (comp_(a, b))
+      return comp_(b, c) ? b : (comp_(a, c) ? c : a);
+    return comp_(a, c) ? a : (comp_(b, c) ? c : b);
+  }
+  void operator ()(It begin, It end) const {
+
+    TaskGroup group(pool_);
+    while ((size_t)(end - begin) > grain_) {
+
+      T pivot = median(*begin, *(begin + (end - begin) / 2), *(end - 1));
+      const Compare &comp = comp_;
+      It lower = std::partition(begin, end, [&pivot, &comp](const T &x) { return comp(x, pivot); });
+      It upper = std::partition(lower, end, [&pivot, &comp](const T &x) { return !comp(pivot, x); }); // [lower, upper) equals pivot: in place already
+      const ParallelSort *self = this;
+      group.run([self, upper, end] { (*self)(upper, end); });
+      end = lower;
+    }
+    std::sort(begin, end, comp_);
+    group.wait();
+  }
+};
+
+template<class It, class Compare> void parallel_sort(It begin, It end, const Compare &comp, size_t grain, ThreadPool &pool) {
+
+  ParallelSort<It, Compare> sort = { pool, grain < 2 ? 2 : grain, comp };
+  sort(begin, end);
+}
+
+template<class It> void parallel_sort(It begin, It end, size_t grain, ThreadPool &pool) {
+
+  parallel_sort(begin, end, std::less<typename std::iterator_traits<It>::value_type>(), grain, pool);
+}
+}
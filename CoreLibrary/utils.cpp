@@ -88,6 +88,7 @@ using namespace std::chrono;
 
 #if defined WINDOWS
 #include <intrin.h>
+#include <malloc.h>
 #pragma intrinsic (_InterlockedDecrement)
 #pragma intrinsic (_InterlockedIncrement)
 #pragma intrinsic (_InterlockedExchange)
@@ -95,11 +96,24 @@ using namespace std::chrono;
 #pragma intrinsic (_InterlockedCompareExchange)
 #pragma intrinsic (_InterlockedCompareExchange64)
 #elif defined LINUX
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <poll.h>
 #endif
 
 #include <algorithm>
 #include <cctype>
 #include <ctime>
+#include <new>
+#include <thread>
+#if defined __i386__ || defined __x86_64__
+#include <immintrin.h>
+#endif
 
 
 #define R250_IA (sizeof(uint32)*103)
@@ -109,23 +123,33 @@ using namespace std::chrono;
 
 namespace core {
 
+static inline void CpuRelax() {
+#if defined WINDOWS
+  YieldProcessor();
+#elif defined __i386__ || defined __x86_64__
+  _mm_pause();
+#endif
+}
+
 #if defined LINUX
-bool CalcTimeout(struct timespec &timeout, uint32 ms) {
+bool CalcTimeout(struct timespec &timeout, uint32 ms, clockid_t clock = CLOCK_REALTIME) {
 
-  struct timeval now;
-  if (gettimeofday(&now, NULL) != 0)
+  if (clock_gettime(clock, &timeout) != 0)
     return false;
 
-  timeout.tv_sec = now.tv_sec + ms / 1000;
-  long us = now.tv_usec + ms % 1000;
-  if (us >= 1000000) {
+  timeout.tv_sec += ms / 1000;
+  timeout.tv_nsec += (long)(ms % 1000) * 1000000; // msec -> nsec
+  if (timeout.tv_nsec >= 1000000000) {
     timeout.tv_sec++;
-    us -= 1000000;
+    timeout.tv_nsec -= 1000000000;
   }
-  timeout.tv_nsec = us * 1000; // usec -> nsec
   return true;
 }
 
+#if defined __GLIBC__ && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 30))
+#define SEM_CLOCKWAIT // waits on the monotonic clock, immune to adjustments of the system time
+#endif
+
 uint64 GetTime() {
   struct timeval tv;
   if (gettimeofday(&tv, NULL))
@@ -281,6 +305,13 @@ void Thread::Sleep() {
 #endif
 }
 
+uint32 Thread::Index() {
+
+  static std::atomic_uint32_t Next(0);
+  static thread_local uint32 Index = Next.fetch_add(1, std::memory_order_relaxed);
+  return Index;
+}
+
 Thread::Thread() : is_meaningful_(false) {
   thread_ = 0;
 }
@@ -436,6 +467,128 @@ std::string Time::ToString_year(Timestamp timestamp) {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
+void *Memory::AlignedAllocate(size_t size) {
+
+  size_t alignment = CacheLineSize;
+  if (size >= HugePageSize)
+    alignment = HugePageSize;
+  else if (size >= PageSize)
+    alignment = PageSize;
+#if defined WINDOWS
+  void *p = _aligned_malloc(size, alignment);
+#elif defined LINUX
+  void *p;
+  if (posix_memalign(&p, alignment, size) != 0)
+    p = NULL;
+#ifdef MADV_HUGEPAGE
+  else if (alignment == HugePageSize)
+    madvise(p, size, MADV_HUGEPAGE);
+#endif
+#endif
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void Memory::AlignedFree(void *p) {
+#if defined WINDOWS
+  _aligned_free(p);
+#elif defined LINUX
+  free(p);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+static std::atomic<BlockPool *> BlockPools(NULL);
+
+BlockPool::BlockPool(size_t size) : size_(size), cached_(0), next_(NULL) {
+
+  for (uint32 i = 0; i < Slots; ++i)
+    slots_[i].store(NULL, std::memory_order_relaxed);
+  size_t cap = DefaultCacheBytes / size;
+  cap_.store(cap < 1 ? 1 : (cap > Slots ? Slots : (uint32)cap), std::memory_order_relaxed);
+}
+
+BlockPool *BlockPool::Get(size_t size) {
+
+  BlockPool *pool = BlockPools.load(std::memory_order_acquire);
+  for (; pool; pool = pool->next_)
+    if (pool->size_ == size)
+      return pool;
+
+  static CriticalSection CS;
+  CS.enter();
+  for (pool = BlockPools.load(std::memory_order_relaxed); pool; pool = pool->next_)
+    if (pool->size_ == size)
+      break;
+  if (!pool) {
+
+    pool = new BlockPool(size);
+    pool->next_ = BlockPools.load(std::memory_order_relaxed);
+    BlockPools.store(pool, std::memory_order_release);
+  }
+  CS.leave();
+  return pool;
+}
+
+void BlockPool::TrimAll(uint32 keep) {
+
+  for (BlockPool *pool = BlockPools.load(std::memory_order_acquire); pool; pool = pool->next_)
+    pool->trim(keep);
+}
+
+void *BlockPool::allocate() {
+
+  if (cached_.load(std::memory_order_relaxed) > 0)
+    for (uint32 i = 0; i < Slots; ++i) {
+
+      if (!slots_[i].load(std::memory_order_relaxed))
+        continue;
+      void *p = slots_[i].exchange(NULL, std::memory_order_acquire);
+      if (p) {
+
+        cached_.fetch_sub(1, std::memory_order_relaxed);
+        return p;
+      }
+    }
+  return Memory::AlignedAllocate(size_);
+}
+
+void BlockPool::deallocate(void *p) {
+
+  if (cached_.fetch_add(1, std::memory_order_relaxed) < cap_.load(std::memory_order_relaxed)) // reserves a slot
+    for (uint32 i = 0; i < Slots; ++i) {
+
+      void *empty = NULL;
+      if (!slots_[i].load(std::memory_order_relaxed) && slots_[i].compare_exchange_strong(empty, p, std::memory_order_release, std::memory_order_relaxed))
+        return;
+    }
+  cached_.fetch_sub(1, std::memory_order_relaxed);
+  Memory::AlignedFree(p);
+}
+
+void BlockPool::trim(uint32 keep) {
+
+  for (uint32 i = 0; i < Slots && cached_.load(std::memory_order_relaxed) > keep; ++i) {
+
+    void *p = slots_[i].exchange(NULL, std::memory_order_acquire);
+    if (p) {
+
+      cached_.fetch_sub(1, std::memory_order_relaxed);
+      Memory::AlignedFree(p);
+    }
+  }
+}
+
+void BlockPool::setCap(uint32 cap) {
+
+  cap_.store(cap > Slots ? Slots : cap, std::memory_order_relaxed);
+  trim(cap);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
 uint8 Host::Name(char *name) {
 #if defined WINDOWS
   DWORD s = 255;
@@ -486,8 +639,15 @@ bool Semaphore::acquire(uint32 timeout) {
   struct timespec t;
   int r;
 
+  if (timeout == Infinite)
+    return sem_wait(&s_) != 0;
+#ifdef SEM_CLOCKWAIT
+  CalcTimeout(t, timeout, CLOCK_MONOTONIC);
+  r = sem_clockwait(&s_, CLOCK_MONOTONIC, &t);
+#else
   CalcTimeout(t, timeout);
   r = sem_timedwait(&s_, &t);
+#endif
   return r != 0;
 #endif
 }
@@ -549,16 +709,30 @@ bool Mutex::acquire(uint32 timeout) {
   uint32 r = WaitForSingleObject(m_, timeout);
   return r == WAIT_TIMEOUT;
 #elif defined LINUX
-  auto start = Time::Get();
-  auto uTimeout = microseconds(timeout * 1000);
+  static const uint32 Spin = std::thread::hardware_concurrency() > 1 ? 256 : 0; // on a single core, the holder cannot release while we spin
+  struct timespec t;
+  int r;
 
-  while (pthread_mutex_trylock(&m_) != 0) {
-    Thread::Sleep(milliseconds(10));
-    if (Time::Get() - start >= uTimeout)
+  if (pthread_mutex_trylock(&m_) == 0)
+    return false;
+  if (timeout == 0)
+    return true;
+  for (uint32 i = 0; i < Spin; ++i) { // holders usually release within microseconds: spare the futex round trip
+
+    CpuRelax();
+    if (pthread_mutex_trylock(&m_) == 0)
       return false;
   }
-  return true;
-
+  if (timeout == Infinite)
+    return pthread_mutex_lock(&m_) != 0;
+#ifdef SEM_CLOCKWAIT
+  CalcTimeout(t, timeout, CLOCK_MONOTONIC);
+  r = pthread_mutex_clocklock(&m_, CLOCK_MONOTONIC, &t);
+#else
+  CalcTimeout(t, timeout);
+  r = pthread_mutex_timedlock(&m_, &t);
+#endif
+  return r != 0;
 #endif
 }
 
@@ -606,56 +780,325 @@ void CriticalSection::leave() {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
+#if defined LINUX
+static uint64 MonotonicNs() {
+
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+TimerService::Timeout::Timeout(timeout_callback callback, void *context) : service_(NULL), deadline_(0), period_(0), callback_(callback), context_(context) {
+}
+
+TimerService::Timeout::~Timeout() {
+
+  TimerService *service = service_.load();
+  if (service)
+    service->cancel(*this);
+}
+
+TimerService::TimerService(microseconds tick) : tick_(tick.count() > 0 ? tick.count() * 1000 : 1000), origin_(MonotonicNs()), now_(0), programmed_(UINT64_MAX), count_(0), running_(NULL), index_(UINT32_MAX), stop_(false) {
+
+  for (uint32 l = 0; l < Levels; ++l)
+    for (uint32 i = 0; i < Slots; ++i)
+      wheel_[l][i].next_ = wheel_[l][i].prev_ = &wheel_[l][i];
+  expired_.next_ = expired_.prev_ = &expired_;
+  fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd_ < 0)
+    std::cerr << "> Error: TimerService: timerfd_create: " << strerror(errno) << std::endl;
+  thread_ = Thread::New<Thread>(Run, this);
+}
+
+TimerService::~TimerService() {
+
+  stop_.store(true);
+  struct itimerspec now;
+  memset(&now, 0, sizeof(now));
+  now.it_value.tv_nsec = 1; // relative: expires right away
+  timerfd_settime(fd_, 0, &now, NULL);
+  Thread::Wait(thread_);
+  delete thread_;
+
+  cs_.enter();
+  for (uint32 l = 0; l < Levels; ++l)
+    for (uint32 i = 0; i < Slots; ++i)
+      while (wheel_[l][i].next_ != &wheel_[l][i]) {
+
+        Timeout *t = static_cast<Timeout *>(wheel_[l][i].next_);
+        Unlink(t);
+        t->service_.store(NULL);
+      }
+  while (expired_.next_ != &expired_) {
+
+    Timeout *t = static_cast<Timeout *>(expired_.next_);
+    Unlink(t);
+    t->service_.store(NULL);
+  }
+  count_ = 0;
+  cs_.leave();
+  close(fd_);
+}
+
+TimerService &TimerService::Default() {
+
+  static TimerService *Service = new TimerService(); // never destroyed: static timers may outlive it otherwise
+  return *Service;
+}
+
+void TimerService::Append(Link &list, Link *l) {
+
+  l->prev_ = list.prev_;
+  l->next_ = &list;
+  list.prev_->next_ = l;
+  list.prev_ = l;
+}
+
+void TimerService::Unlink(Link *l) {
+
+  l->prev_->next_ = l->next_;
+  l->next_->prev_ = l->prev_;
+  l->next_ = l->prev_ = NULL;
+}
+
+uint64 TimerService::ticks() const {
+
+  return (MonotonicNs() - origin_) / tick_;
+}
+
+uint64 TimerService::insert(Timeout *t) {
+
+  uint64 deadline = t->deadline_;
+  if (deadline <= now_) {
+
+    Append(expired_, t);
+    return now_;
+  }
+  uint64 delta = deadline - now_;
+  if (delta >= (1ull << (8 * Levels))) { // beyond the wheel: parked in the last slot in reach, from which it cascades back here
+
+    delta = (1ull << (8 * Levels)) - 1;
+    deadline = now_ + delta;
+  }
+  uint32 level = 0;
+  while (level < Levels - 1 && delta >= (1ull << (8 * (level + 1))))
+    ++level;
+  uint32 shift = 8 * level;
+  Append(wheel_[level][(deadline >> shift) & (Slots - 1)], t);
+  return (deadline >> shift) << shift; // where the slot cascades, or expires at level 0
+}
+
+void TimerService::advance(uint64 to) {
+
+  while (now_ < to) {
+
+    uint64 next = this->next();
+    if (next > to) {
+
+      now_ = to;
+      return;
+    }
+    now_ = next;
+    uint32 top = 0; // cascades from the highest level down, so that the timeouts land in slots not yet cascaded
+    while (top < Levels - 1 && (now_ & ((1ull << (8 * (top + 1))) - 1)) == 0)
+      ++top;
+    for (uint32 level = top; level > 0; --level) {
+
+      Link &slot = wheel_[level][(now_ >> (8 * level)) & (Slots - 1)];
+      while (slot.next_ != &slot) {
+
+        Timeout *t = static_cast<Timeout *>(slot.next_);
+        Unlink(t);
+        insert(t);
+      }
+    }
+    Link &slot = wheel_[0][now_ & (Slots - 1)];
+    while (slot.next_ != &slot) {
+
+      Link *l = slot.next_;
+      Unlink(l);
+      Append(expired_, l);
+    }
+  }
+}
+
+uint64 TimerService::next() const {
+
+  uint64 next = UINT64_MAX;
+  for (uint32 level = 0; level < Levels; ++level) {
+
+    uint32 shift = 8 * level;
+    uint64 block = now_ >> shift;
+    for (uint32 i = 1; i <= Slots; ++i)
+      if (wheel_[level][(block + i) & (Slots - 1)].next_ != &wheel_[level][(block + i) & (Slots - 1)]) {
+
+        if (((block + i) << shift) < next)
+          next = (block + i) << shift;
+        break;
+      }
+  }
+  return next;
+}
+
+void TimerService::program(uint64 tick) {
+
+  programmed_ = tick;
+  struct itimerspec at;
+  memset(&at, 0, sizeof(at)); // disarms
+  if (tick != UINT64_MAX) {
+
+    uint64 ns = origin_ + tick * tick_;
+    at.it_value.tv_sec = ns / 1000000000;
+    at.it_value.tv_nsec = ns % 1000000000;
+  }
+  timerfd_settime(fd_, TFD_TIMER_ABSTIME, &at, NULL);
+}
+
+thread_ret thread_function_call TimerService::Run(void *args) {
+
+  TimerService *s = (TimerService *)args;
+  s->cs_.enter();
+  s->index_ = Thread::Index();
+  s->cs_.leave();
+
+  struct pollfd fd;
+  fd.fd = s->fd_;
+  fd.events = POLLIN;
+  while (!s->stop_.load()) {
+
+    fd.revents = 0;
+    if (poll(&fd, 1, -1) < 0)
+      continue; // EINTR
+    uint64 expirations;
+    if (read(s->fd_, &expirations, sizeof(expirations)) < 0) // resets the timerfd
+      continue;
+    if (s->stop_.load())
+      break;
+
+    s->cs_.enter();
+    s->advance(s->ticks());
+    while (s->expired_.next_ != &s->expired_) {
+
+      Timeout *t = static_cast<Timeout *>(s->expired_.next_);
+      Unlink(t);
+      if (t->period_) { // rearmed before the callback runs, which may cancel it
+
+        if (t->deadline_ + t->period_ > s->now_)
+          t->deadline_ += t->period_;
+        else // late: skips the periods missed
+          t->deadline_ += ((s->now_ - t->deadline_) / t->period_ + 1) * t->period_;
+        s->insert(t);
+      } else
+        --s->count_;
+      s->running_ = t;
+      s->cs_.leave();
+      t->callback_(t->context_);
+      s->cs_.enter();
+      if (s->running_ == t) { // otherwise cancelled from its callback, and possibly destroyed
+
+        if (!t->next_)
+          t->service_.store(NULL);
+        s->running_ = NULL;
+      }
+    }
+    s->program(s->next());
+    s->cs_.leave();
+  }
+  thread_ret_val(0);
+}
+
+void TimerService::arm(Timeout &t, microseconds delay, microseconds period) {
+
+  TimerService *service = t.service_.load();
+  if (service && service != this)
+    service->cancel(t);
+
+  uint64 ns = MonotonicNs() - origin_ + (delay.count() > 0 ? delay.count() * 1000 : 0);
+  cs_.enter();
+  if (t.next_)
+    Unlink(&t);
+  else if (count_++ == 0) // the wheel is empty: jumps to the present
+    now_ = ticks();
+  t.deadline_ = (ns + tick_ - 1) / tick_; // rounded up: never early
+  t.period_ = period.count() > 0 ? (period.count() * 1000 + tick_ - 1) / tick_ : 0;
+  t.service_.store(this);
+  uint64 tick = insert(&t);
+  if (tick < programmed_)
+    program(tick);
+  cs_.leave();
+}
+
+void TimerService::arm_until(Timeout &t, Timestamp deadline, microseconds period) {
+
+  arm(t, duration_cast<microseconds>(deadline - Time::Get()), period);
+}
+
+bool TimerService::cancel(Timeout &t) {
+
+  cs_.enter();
+  bool armed = t.next_ != NULL;
+  if (running_ == &t) {
+
+    if (Thread::Index() == index_)
+      running_ = NULL; // from its own callback: t may be destroyed when it returns
+    else
+      while (running_ == &t) {
+
+        cs_.leave();
+        std::this_thread::yield();
+        cs_.enter();
+      }
+  }
+  if (t.next_) { // possibly rearmed by its callback
+
+    Unlink(&t);
+    --count_;
+  }
+  t.service_.store(NULL);
+  cs_.leave();
+  return armed;
+}
+
+uint32 TimerService::armed() {
+
+  cs_.enter();
+  uint32 count = count_;
+  cs_.leave();
+  return count;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
 #if defined WINDOWS
 const uint32 Timer::Infinite = INFINITE;
 #elif defined LINUX
 const uint32 Timer::Infinite = INT_MAX;
 
-static void timer_signal_handler(int sig, siginfo_t *siginfo, void *context) {
-  SemaTex* sematex = (SemaTex*)siginfo->si_value.sival_ptr;
-  if (sematex == NULL)
-    return;
-  pthread_mutex_lock(&sematex->mutex);
-  pthread_cond_broadcast(&sematex->semaphore);
-  pthread_mutex_unlock(&sematex->mutex);
+void Timer::Fire(void *context) {
+
+  ((Event *)context)->fire();
 }
 #endif
 
-Timer::Timer() {
 #if defined WINDOWS
+Timer::Timer() {
   t_ = CreateWaitableTimer(NULL, false, NULL);
   if (t_ == NULL) {
     printf("Error creating timer\n");
   }
+}
 #elif defined LINUX
-  pthread_cond_init(&sematex.semaphore, NULL);
-  pthread_mutex_init(&sematex.mutex, NULL);
-
-  struct sigaction sa;
-  struct sigevent timer_event;
-
-  sigemptyset(&sa.sa_mask);
-  sa.sa_flags = SA_SIGINFO;   /* Real-Time signal */
-  sa.sa_sigaction = timer_signal_handler;
-  sigaction(SIGRTMIN, &sa, NULL);
-
-  timer_event.sigev_notify = SIGEV_SIGNAL;
-  timer_event.sigev_signo = SIGRTMIN;
-  timer_event.sigev_value.sival_ptr = (void *)&sematex;
-  int ret = timer_create(CLOCK_REALTIME, &timer_event, &timer);
-  if (ret != 0) {
-    printf("Error creating timer: %d\n", ret);
-  }
-#endif
+Timer::Timer() : event_(false), timeout_(Fire, &event_) {
 }
+#endif
 
 Timer::~Timer() {
 #if defined WINDOWS
   CloseHandle(t_);
 #elif defined LINUX
-  pthread_cond_destroy(&sematex.semaphore);
-  pthread_mutex_destroy(&sematex.mutex);
-  timer_delete(timer);
+  TimerService::Default().cancel(timeout_);
 #endif
 }
 
@@ -668,25 +1111,10 @@ void Timer::start(microseconds deadline, milliseconds period) {
     printf("Error arming timer\n");
   }
 #elif defined LINUX
-  struct itimerspec newtv;
-  sigset_t allsigs;
-
-  uint64 t = deadline.count();
-  uint64 p = period.count() * 1000;
-  newtv.it_interval.tv_sec = p / 1000000;
-  newtv.it_interval.tv_nsec = (p % 1000000) * 1000;
-  newtv.it_value.tv_sec = t / 1000000;
-  newtv.it_value.tv_nsec = (t % 1000000) * 1000;
-
-  pthread_mutex_lock(&sematex.mutex);
-
-  int ret = timer_settime(timer, 0, &newtv, NULL);
-  if (ret != 0) {
-    printf("Error arming timer: %d\n", ret);
-  }
-  sigemptyset(&allsigs);
-
-  pthread_mutex_unlock(&sematex.mutex);
+  TimerService &service = TimerService::Default();
+  service.cancel(timeout_);
+  event_.reset(); // rearming drops a pending expiry, as on windows
+  service.arm(timeout_, deadline, duration_cast<microseconds>(period));
 #endif
 }
 
@@ -695,29 +1123,26 @@ bool Timer::wait(uint32 timeout) {
   uint32 r = WaitForSingleObject(t_, timeout);
   return r == WAIT_TIMEOUT;
 #elif defined LINUX
-  bool res;
-  struct timespec ttimeout;
-
-  pthread_mutex_lock(&sematex.mutex);
-  if (timeout == INT_MAX) {
-    res = (pthread_cond_wait(&sematex.semaphore, &sematex.mutex) != 0);
-  }
-  else {
-    CalcTimeout(ttimeout, timeout);
-    res = (pthread_cond_timedwait(&sematex.semaphore, &sematex.mutex, &ttimeout) != 0);
-  }
-  pthread_mutex_unlock(&sematex.mutex);
-  return res;
+  return event_.wait_for(timeout);
 #endif
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
-Event::Event() {
 #if defined WINDOWS
-  e_ = CreateEvent(NULL, true, false, NULL);
+const uint32 Event::Infinite = INFINITE;
+#elif defined LINUX
+const uint32 Event::Infinite = INT_MAX;
+#endif
+
+Event::Event(bool manualReset) {
+#if defined WINDOWS
+  e_ = CreateEvent(NULL, manualReset, false, NULL);
 #elif defined LINUX
-  // TODO.
+  fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  manualReset_ = manualReset;
+  if (fd_ < 0)
+    std::cerr << "> Error: Event: eventfd: " << strerror(errno) << std::endl;
 #endif
 }
 
@@ -725,15 +1150,41 @@ Event::~Event() {
 #if defined WINDOWS
   CloseHandle(e_);
 #elif defined LINUX
-  // TODO.
+  if (fd_ >= 0)
+    close(fd_);
 #endif
 }
 
+#if defined LINUX
+bool Event::take() {
+
+  if (manualReset_) {
+
+    struct pollfd fd;
+    fd.fd = fd_;
+    fd.events = POLLIN;
+    fd.revents = 0;
+    return poll(&fd, 1, 0) > 0;
+  }
+  uint64 count;
+  return read(fd_, &count, sizeof(count)) == sizeof(count); // resets the eventfd; fails if another waiter was faster
+}
+#endif
+
 void Event::wait() {
 #if defined WINDOWS
   WaitForSingleObject(e_, INFINITE);
 #elif defined LINUX
-  // TODO.
+  while (wait_for(Infinite));
+#endif
+}
+
+bool Event::wait_for(uint32 timeout) {
+#if defined WINDOWS
+  return WaitForSingleObject(e_, timeout) == WAIT_TIMEOUT;
+#elif defined LINUX
+  Event *self = this;
+  return WaitAny(&self, 1, timeout) < 0;
 #endif
 }
 
@@ -741,7 +1192,9 @@ void Event::fire() {
 #if defined WINDOWS
   SetEvent(e_);
 #elif defined LINUX
-  // TODO.
+  uint64 one = 1;
+  if (write(fd_, &one, sizeof(one)) < 0) // cannot overflow: taking the event resets the eventfd
+    return;
 #endif
 }
 
@@ -749,7 +1202,50 @@ void Event::reset() {
 #if defined WINDOWS
   ResetEvent(e_);
 #elif defined LINUX
-  // TODO.
+  uint64 count;
+  if (read(fd_, &count, sizeof(count)) < 0) // fails if not fired
+    return;
+#endif
+}
+
+int32 Event::WaitAny(Event **events, uint32 count, uint32 timeout) {
+#if defined WINDOWS
+  std::vector<HANDLE> handles(count); // up to MAXIMUM_WAIT_OBJECTS
+  for (uint32 i = 0; i < count; ++i)
+    handles[i] = events[i]->e_;
+  uint32 r = WaitForMultipleObjects(count, &handles[0], false, timeout);
+  return r < WAIT_OBJECT_0 + count ? (int32)(r - WAIT_OBJECT_0) : -1;
+#elif defined LINUX
+  std::vector<struct pollfd> fds(count);
+  for (uint32 i = 0; i < count; ++i) {
+
+    fds[i].fd = events[i]->fd_;
+    fds[i].events = POLLIN;
+  }
+  struct timespec deadline;
+  if (timeout != Infinite)
+    CalcTimeout(deadline, timeout, CLOCK_MONOTONIC);
+  for (;;) {
+
+    int wait = -1;
+    if (timeout != Infinite) {
+
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      int64 left = (int64)(deadline.tv_sec - now.tv_sec) * 1000 + (deadline.tv_nsec - now.tv_nsec + 999999) / 1000000; // rounded up
+      wait = left > 0 ? (int)left : 0;
+    }
+    for (uint32 i = 0; i < count; ++i)
+      fds[i].revents = 0;
+    int r = poll(&fds[0], count, wait);
+    if (r < 0 && errno != EINTR)
+      return -1;
+    for (uint32 i = 0; r > 0 && i < count; ++i)
+      if (fds[i].revents && events[i]->take())
+        return (int32)i;
+    if (r == 0 && wait == 0)
+      return -1;
+  }
 #endif
 }
 
@@ -839,6 +1335,758 @@ void FastSemaphore::release() {
     Semaphore::release();
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if defined WINDOWS
+const uint32 LightweightSemaphore::Infinite = INFINITE;
+#elif defined LINUX
+const uint32 LightweightSemaphore::Infinite = INT_MAX;
+#endif
+
+std::atomic_uint32_t LightweightSemaphore::MaxSpin_(std::thread::hardware_concurrency() > 1 ? 4096 : 0); // on a single core, the releaser cannot run while we spin
+
+LightweightSemaphore::LightweightSemaphore(uint32 initialCount) : count_(initialCount), s_(0, 65535), selector_(NULL), spin_(256) {
+}
+
+LightweightSemaphore::~LightweightSemaphore() {
+}
+
+bool LightweightSemaphore::spin() {
+
+  int32 max = (int32)MaxSpin_.load(std::memory_order_relaxed);
+  if (!max)
+    return false;
+  int32 budget = spin_.load(std::memory_order_relaxed);
+  if (budget > max)
+    budget = max;
+  for (int32 i = 0; i < budget; ++i) {
+
+    if (count_.load(std::memory_order_relaxed) > 0 && try_acquire()) {
+
+      spin_.store(budget + (2 * i + 64 - budget) / 8, std::memory_order_relaxed); // moves towards twice the gap observed
+      return true;
+    }
+    if ((i & 63) == 63)
+      std::this_thread::yield();
+    else
+      CpuRelax();
+  }
+  spin_.store(budget - budget / 8 > 64 ? budget - budget / 8 : 64, std::memory_order_relaxed); // the gap was longer than the budget: spin less
+  return false;
+}
+
+void LightweightSemaphore::acquire() {
+
+  if (count_.load(std::memory_order_relaxed) <= 0 && spin())
+    return;
+  if (count_.fetch_sub(1, std::memory_order_acq_rel) <= 0) // exhausted: sleep until release() hands over a unit
+    while (s_.acquire()); // an infinite wait can only be interrupted
+}
+
+bool LightweightSemaphore::acquire(uint32 timeout) {
+
+  if (timeout && count_.load(std::memory_order_relaxed) <= 0 && spin())
+    return false;
+  if (count_.fetch_sub(1, std::memory_order_acq_rel) > 0)
+    return false;
+  if (!s_.acquire(timeout))
+    return false;
+
+  int32 count = count_.load();
+  while (count < 0) // no unit has been handed over yet: stop sleeping
+    if (count_.compare_exchange_weak(count, count + 1))
+      return true;
+  while (s_.acquire()); // release() has just been called for us
+  return false;
+}
+
+uint32 LightweightSemaphore::acquire(uint32 max, uint32 timeout) {
+
+  if (!max)
+    return 0;
+  uint32 n = try_acquire(max);
+  if (n || !timeout || acquire(timeout))
+    return n;
+  return 1 + try_acquire(max - 1);
+}
+
+uint32 LightweightSemaphore::try_acquire(uint32 max) {
+
+  int32 count = count_.load(std::memory_order_relaxed);
+  while (count > 0) {
+
+    uint32 n = (uint32)count < max ? count : max;
+    if (count_.compare_exchange_weak(count, count - n, std::memory_order_acq_rel))
+      return n;
+  }
+  return 0;
+}
+
+void LightweightSemaphore::release(uint32 count) {
+
+  int32 c = count_.fetch_add(count, std::memory_order_acq_rel);
+  if (c < 0) // threads are sleeping
+    s_.release(-c < (int32)count ? -c : count);
+  Selector *selector = selector_.load(std::memory_order_acquire);
+  if (selector)
+    selector->notify();
+}
+
+int32 LightweightSemaphore::count() const {
+
+  return count_.load(std::memory_order_relaxed);
+}
+
+void LightweightSemaphore::SetMaxSpin(uint32 iterations) {
+
+  MaxSpin_.store(iterations, std::memory_order_relaxed);
+}
+
+uint32 LightweightSemaphore::MaxSpin() {
+
+  return MaxSpin_.load(std::memory_order_relaxed);
+}
+
+uint32 LightweightSemaphore::TimeoutUntil(Timestamp deadline) {
+
+  int64 us = duration_cast<microseconds>(deadline - Time::Get()).count();
+  if (us <= 0)
+    return 0;
+  int64 ms = (us + 999) / 1000;
+  return ms < Infinite ? (uint32)ms : Infinite - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if defined WINDOWS
+const uint32 Selector::Infinite = INFINITE;
+#elif defined LINUX
+const uint32 Selector::Infinite = INT_MAX;
+#endif
+
+Selector::Selector() : next_(0), armed_(false) {
+#if defined WINDOWS
+  wake_ = CreateSemaphore(NULL, 0, 1, NULL);
+#elif defined LINUX
+  wake_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+}
+
+Selector::~Selector() {
+
+  for (uint32 i = 0; i < sources_.size(); ++i)
+    if (sources_[i].semaphore_)
+      sources_[i].semaphore_->selector_.store(NULL);
+#if defined WINDOWS
+  for (uint32 i = 0; i < events_.size(); ++i)
+    WSACloseEvent(events_[i]);
+  CloseHandle(wake_);
+#elif defined LINUX
+  close(wake_);
+#endif
+}
+
+uint32 Selector::add(LightweightSemaphore *s) {
+
+  Source source;
+  source.semaphore_ = s;
+  source.socket_ = INVALID_SOCKET;
+  sources_.push_back(source);
+  s->selector_.store(this, std::memory_order_release);
+  return (uint32)sources_.size() - 1;
+}
+
+uint32 Selector::add(socket s) {
+
+  Source source;
+  source.semaphore_ = NULL;
+  source.socket_ = s;
+  sources_.push_back(source);
+#if defined WINDOWS
+  event e = WSACreateEvent();
+  WSAEventSelect(s, e, FD_READ | FD_ACCEPT | FD_CLOSE);
+  events_.push_back(e);
+#endif
+  return (uint32)sources_.size() - 1;
+}
+
+int32 Selector::ready() {
+
+  uint32 size = (uint32)sources_.size();
+  for (uint32 i = 0; i < size; ++i) {
+
+    uint32 index = (next_ + i) % size;
+    LightweightSemaphore *s = sources_[index].semaphore_;
+    if (s && s->count() > 0) {
+
+      next_ = index + 1;
+      return index;
+    }
+  }
+  return -1;
+}
+
+bool Selector::sleep(uint32 timeout, int32 &index) {
+
+  index = -1;
+#if defined WINDOWS
+  std::vector<HANDLE> handles(events_);
+  handles.push_back(wake_);
+  DWORD r = WaitForMultipleObjects((DWORD)handles.size(), &handles[0], false, timeout);
+  if (r == WAIT_TIMEOUT)
+    return true;
+  if (r < WAIT_OBJECT_0 + events_.size()) {
+
+    uint32 e = r - WAIT_OBJECT_0;
+    for (uint32 i = 0; i < sources_.size(); ++i)
+      if (!sources_[i].semaphore_ && e-- == 0) {
+
+        WSANETWORKEVENTS events;
+        WSAEnumNetworkEvents(sources_[i].socket_, events_[r - WAIT_OBJECT_0], &events); // resets the event
+        index = i;
+        break;
+      }
+  }
+  return false;
+#elif defined LINUX
+  std::vector<struct pollfd> fds;
+  struct pollfd fd;
+  fd.fd = wake_;
+  fd.events = POLLIN;
+  fd.revents = 0;
+  fds.push_back(fd);
+  for (uint32 i = 0; i < sources_.size(); ++i)
+    if (!sources_[i].semaphore_) {
+
+      fd.fd = sources_[i].socket_;
+      fds.push_back(fd);
+    }
+  int r = poll(&fds[0], fds.size(), timeout == Infinite ? -1 : (int)timeout);
+  if (r == 0)
+    return true;
+  if (r < 0) // interrupted
+    return false;
+  if (fds[0].revents) {
+
+    uint64_t count;
+    if (read(wake_, &count, sizeof(count)) < 0) // resets the eventfd
+      return false;
+  }
+  for (uint32 i = 0, f = 1; i < sources_.size(); ++i)
+    if (!sources_[i].semaphore_ && fds[f++].revents) {
+
+      index = i;
+      break;
+    }
+  return false;
+#endif
+}
+
+int32 Selector::wait(uint32 timeout) {
+
+  Timestamp deadline = Time::Get() + milliseconds(timeout);
+  for (;;) {
+
+    armed_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with notify(): either we see the new unit or the releaser sees armed_
+    int32 index = ready();
+    if (index >= 0) {
+
+      armed_.store(false, std::memory_order_relaxed);
+      return index;
+    }
+    bool timedout = sleep(timeout == Infinite ? Infinite : LightweightSemaphore::TimeoutUntil(deadline), index);
+    armed_.store(false, std::memory_order_relaxed);
+    if (index >= 0)
+      return index;
+    if (timedout)
+      return ready();
+  }
+}
+
+void Selector::notify() {
+
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!armed_.load(std::memory_order_relaxed) || !armed_.exchange(false))
+    return;
+#if defined WINDOWS
+  ReleaseSemaphore(wake_, 1, NULL);
+#elif defined LINUX
+  uint64_t one = 1;
+  if (write(wake_, &one, sizeof(one)) < 0) // cannot overflow: the waiting thread resets the eventfd
+    return;
+#endif
+}
+
+#if defined LINUX
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+SharedMemory::SharedMemory() : fd_(-1), base_(NULL), size_(0), owner_(false) {
+}
+
+SharedMemory::~SharedMemory() {
+
+  close();
+}
+
+SharedMemory *SharedMemory::create(const char *name, size_t size) {
+
+  close();
+  fd_ = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd_ < 0) {
+
+    std::cerr << "> Error: unable to create shared memory " << name << " :" << strerror(errno) << std::endl;
+    return NULL;
+  }
+  name_ = name;
+  owner_ = true;
+  if (ftruncate(fd_, size) != 0) { // zero-filled
+
+    std::cerr << "> Error: unable to size shared memory " << name << " :" << strerror(errno) << std::endl;
+    close();
+    return NULL;
+  }
+  base_ = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (base_ == MAP_FAILED) {
+
+    std::cerr << "> Error: unable to map shared memory " << name << " :" << strerror(errno) << std::endl;
+    base_ = NULL;
+    close();
+    return NULL;
+  }
+  size_ = size;
+  return this;
+}
+
+SharedMemory *SharedMemory::open(const char *name, size_t size) {
+
+  close();
+  fd_ = shm_open(name, O_RDWR, 0600);
+  if (fd_ < 0)
+    return NULL;
+  struct stat info;
+  if (fstat(fd_, &info) != 0 || (size_t)info.st_size < size) { // or not sized yet by its creator
+
+    close();
+    return NULL;
+  }
+  base_ = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (base_ == MAP_FAILED) {
+
+    std::cerr << "> Error: unable to map shared memory " << name << " :" << strerror(errno) << std::endl;
+    base_ = NULL;
+    close();
+    return NULL;
+  }
+  name_ = name;
+  size_ = size;
+  return this;
+}
+
+void SharedMemory::close() {
+
+  if (base_)
+    munmap(base_, size_);
+  if (fd_ >= 0)
+    ::close(fd_);
+  if (owner_)
+    shm_unlink(name_.c_str()); // processes having it mapped keep it until they close it
+  fd_ = -1;
+  base_ = NULL;
+  size_ = 0;
+  owner_ = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+SpillFile::SpillFile() : fd_(-1), chunkBytes_(0), stride_(0), written_(0), read_(0) {
+}
+
+SpillFile::~SpillFile() {
+
+  close();
+}
+
+SpillFile *SpillFile::open(const char *path, size_t chunkBytes) {
+
+  close();
+  fd_ = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd_ < 0) {
+
+    std::cerr << "> Error: unable to open spill file " << path << " :" << strerror(errno) << std::endl;
+    return NULL;
+  }
+  path_ = path;
+  chunkBytes_ = chunkBytes;
+  stride_ = (chunkBytes + Memory::PageSize - 1) & ~(size_t)(Memory::PageSize - 1);
+  return this;
+}
+
+void SpillFile::close() {
+
+  if (fd_ < 0)
+    return;
+  ::close(fd_);
+  unlink(path_.c_str());
+  fd_ = -1;
+  written_ = read_ = 0;
+}
+
+bool SpillFile::append(const void *chunk) {
+
+  if (fd_ < 0)
+    return false;
+  off_t offset = (off_t)(written_ * stride_);
+  for (size_t done = 0; done < chunkBytes_;) {
+
+    ssize_t n = pwrite(fd_, (const char *)chunk + done, chunkBytes_ - done, offset + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+
+      std::cerr << "> Error: unable to write spill file " << path_ << " :" << strerror(errno) << std::endl;
+      return false;
+    }
+    done += n;
+  }
+  ++written_;
+  return true;
+}
+
+const void *SpillFile::map() {
+
+  if (read_ == written_)
+    return NULL;
+  void *chunk = mmap(NULL, chunkBytes_, PROT_READ, MAP_PRIVATE, fd_, (off_t)(read_ * stride_));
+  if (chunk == MAP_FAILED) {
+
+    std::cerr << "> Error: unable to map spill file " << path_ << " :" << strerror(errno) << std::endl;
+    return NULL;
+  }
+  ++read_;
+  madvise(chunk, chunkBytes_, MADV_SEQUENTIAL);
+  return chunk;
+}
+
+bool SpillFile::read(void *chunk) {
+
+  if (read_ == written_)
+    return false;
+  off_t offset = (off_t)(read_ * stride_);
+  for (size_t done = 0; done < chunkBytes_;) {
+
+    ssize_t n = pread(fd_, (char *)chunk + done, chunkBytes_ - done, offset + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+
+      std::cerr << "> Error: unable to read spill file " << path_ << " :" << (n ? strerror(errno) : "truncated") << std::endl;
+      return false;
+    }
+    done += n;
+  }
+  ++read_;
+  return true;
+}
+
+void SpillFile::skip() {
+
+  if (read_ < written_)
+    ++read_;
+}
+
+void SpillFile::unmap(const void *chunk) {
+
+  munmap((void *)chunk, chunkBytes_);
+}
+
+void SpillFile::reset() {
+
+  if (fd_ >= 0 && written_ && ftruncate(fd_, 0) != 0)
+    std::cerr << "> Error: unable to truncate spill file " << path_ << " :" << strerror(errno) << std::endl;
+  written_ = read_ = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint32 SharedSemaphore::Infinite = INT_MAX;
+
+static int Futex(std::atomic_int32_t *address, int op, int32 value, const struct timespec *timeout) { // not private: shared between processes
+
+  return syscall(SYS_futex, (int32 *)address, op, value, timeout, NULL, 0);
+}
+
+void SharedSemaphore::init(uint32 initialCount) {
+
+  count_.store(initialCount);
+  sleepers_.store(0);
+}
+
+bool SharedSemaphore::acquire(uint32 timeout) {
+
+  struct timespec deadline;
+  if (timeout != Infinite)
+    CalcTimeout(deadline, timeout, CLOCK_MONOTONIC);
+  for (;;) {
+
+    if (try_acquire())
+      return false;
+    struct timespec left;
+    if (timeout != Infinite) {
+
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      left.tv_sec = deadline.tv_sec - now.tv_sec;
+      left.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+      if (left.tv_nsec < 0) {
+
+        left.tv_sec--;
+        left.tv_nsec += 1000000000;
+      }
+      if (left.tv_sec < 0)
+        return true;
+    }
+    sleepers_.fetch_add(1); // seen by release() unless it has already made a unit available, which makes the futex return at once
+    Futex(&count_, FUTEX_WAIT, 0, timeout == Infinite ? NULL : &left);
+    sleepers_.fetch_sub(1);
+  }
+}
+
+bool SharedSemaphore::try_acquire() {
+
+  int32 count = count_.load(std::memory_order_relaxed);
+  while (count > 0)
+    if (count_.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel))
+      return true;
+  return false;
+}
+
+void SharedSemaphore::release(uint32 count) {
+
+  count_.fetch_add(count);
+  if (sleepers_.load() > 0)
+    Futex(&count_, FUTEX_WAKE, count < INT_MAX ? count : INT_MAX, NULL);
+}
+
+int32 SharedSemaphore::count() const {
+
+  return count_.load(std::memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool IsRunning(int32 id) {
+
+  if (kill(id, 0) != 0 && errno == ESRCH)
+    return false;
+  char path[32];
+  snprintf(path, sizeof(path), "/proc/%d/stat", id);
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return true;
+  char line[512];
+  bool running = true;
+  if (fgets(line, sizeof(line), f)) {
+
+    const char *state = strrchr(line, ')'); // after the command name, which may contain anything
+    running = !state || (state[2] != 'Z' && state[2] != 'X'); // not a zombie
+  }
+  fclose(f);
+  return running;
+}
+
+bool SharedPeers::attach() {
+
+  int32 id = getpid();
+  for (uint32 i = 0; i < Max; ++i) {
+
+    int32 free = 0;
+    if (ids_[i].compare_exchange_strong(free, id)) {
+
+      attached_.store(true);
+      return true;
+    }
+  }
+  alive(); // frees the entries of the dead
+  for (uint32 i = 0; i < Max; ++i) {
+
+    int32 free = 0;
+    if (ids_[i].compare_exchange_strong(free, id)) {
+
+      attached_.store(true);
+      return true;
+    }
+  }
+  return false;
+}
+
+void SharedPeers::detach() {
+
+  int32 id = getpid();
+  for (uint32 i = 0; i < Max; ++i) {
+
+    int32 attached = id;
+    if (ids_[i].compare_exchange_strong(attached, 0))
+      return;
+  }
+}
+
+uint32 SharedPeers::alive() {
+
+  uint32 n = 0;
+  for (uint32 i = 0; i < Max; ++i) {
+
+    int32 id = ids_[i].load();
+    if (!id)
+      continue;
+    if (IsRunning(id))
+      ++n;
+    else
+      ids_[i].compare_exchange_strong(id, 0);
+  }
+  return n;
+}
+
+bool SharedPeers::gone() {
+
+  return attached_.load() && !alive();
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+static PipeStats *PipeStatsRegistry = NULL;
+
+static CriticalSection &PipeStatsCS() {
+
+  static CriticalSection CS;
+  return CS;
+}
+
+PipeStats::PipeStats(const LightweightSemaphore *items) : items_(items), highWater_(0), prev_(NULL) {
+
+  for (uint32 i = 0; i < Shards; ++i) {
+
+    Shard &s = shards_[i];
+    s.pushes_.store(0, std::memory_order_relaxed);
+    s.pops_.store(0, std::memory_order_relaxed);
+    s.blocks_.store(0, std::memory_order_relaxed);
+    for (uint32 b = 0; b < Buckets; ++b) {
+
+      s.waits_[b].store(0, std::memory_order_relaxed);
+      s.locks_[b].store(0, std::memory_order_relaxed);
+    }
+  }
+  PipeStatsCS().enter();
+  next_ = PipeStatsRegistry;
+  if (next_)
+    next_->prev_ = this;
+  PipeStatsRegistry = this;
+  PipeStatsCS().leave();
+}
+
+PipeStats::~PipeStats() {
+
+  PipeStatsCS().enter();
+  if (prev_)
+    prev_->next_ = next_;
+  else
+    PipeStatsRegistry = next_;
+  if (next_)
+    next_->prev_ = prev_;
+  PipeStatsCS().leave();
+}
+
+uint32 PipeStats::Bucket(uint64 us) {
+
+  uint32 b = 0;
+  while (us && b < Buckets - 1) {
+
+    us >>= 1;
+    ++b;
+  }
+  return b;
+}
+
+uint64 PipeStats::Now() {
+
+  return duration_cast<microseconds>(Time::Get().time_since_epoch()).count();
+}
+
+void PipeStats::setName(const std::string &name) {
+
+  PipeStatsCS().enter();
+  name_ = name;
+  PipeStatsCS().leave();
+}
+
+void PipeStats::pushed(uint32 n) {
+
+  shards_[Thread::Index() % Shards].pushes_.fetch_add(n, std::memory_order_relaxed);
+  int32 depth = items_->count();
+  int32 high = highWater_.load(std::memory_order_relaxed);
+  while (depth > high && !highWater_.compare_exchange_weak(high, depth, std::memory_order_relaxed));
+}
+
+void PipeStats::popped(uint32 n) {
+
+  shards_[Thread::Index() % Shards].pops_.fetch_add(n, std::memory_order_relaxed);
+}
+
+void PipeStats::blockAllocated() {
+
+  shards_[Thread::Index() % Shards].blocks_.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64 PipeStats::waitStart() const {
+
+  return items_->count() > 0 ? 0 : Now();
+}
+
+void PipeStats::waited(uint64 start) {
+
+  if (start)
+    shards_[Thread::Index() % Shards].waits_[Bucket(Now() - start)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void PipeStats::locked(uint64 start) {
+
+  shards_[Thread::Index() % Shards].locks_[Bucket(Now() - start)].fetch_add(1, std::memory_order_relaxed);
+}
+
+PipeStats::Snapshot PipeStats::snapshot() const {
+
+  Snapshot snapshot;
+  snapshot.name_ = name_;
+  int32 depth = items_->count();
+  snapshot.depth_ = depth > 0 ? depth : 0;
+  snapshot.highWater_ = highWater_.load(std::memory_order_relaxed);
+  snapshot.pushes_ = snapshot.pops_ = snapshot.blocks_ = 0;
+  for (uint32 b = 0; b < Buckets; ++b)
+    snapshot.waits_[b] = snapshot.locks_[b] = 0;
+  for (uint32 i = 0; i < Shards; ++i) {
+
+    const Shard &s = shards_[i];
+    snapshot.pushes_ += s.pushes_.load(std::memory_order_relaxed);
+    snapshot.pops_ += s.pops_.load(std::memory_order_relaxed);
+    snapshot.blocks_ += s.blocks_.load(std::memory_order_relaxed);
+    for (uint32 b = 0; b < Buckets; ++b) {
+
+      snapshot.waits_[b] += s.waits_[b].load(std::memory_order_relaxed);
+      snapshot.locks_[b] += s.locks_[b].load(std::memory_order_relaxed);
+    }
+  }
+  return snapshot;
+}
+
+void PipeStats::SnapshotAll(std::vector<Snapshot> &snapshots) {
+
+  PipeStatsCS().enter();
+  for (PipeStats *s = PipeStatsRegistry; s; s = s->next_)
+    snapshots.push_back(s->snapshot());
+  PipeStatsCS().leave();
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 /*
   FastMutex::FastMutex(uint32 initialCount):Semaphore(initialCount,1),count_(initialCount){
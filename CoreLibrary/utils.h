@@ -90,6 +90,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 #include <atomic>
 
 #if defined WINDOWS
@@ -138,14 +139,6 @@ public:
   static void PrintBinary(void* p, uint32 size, bool asInt, const char* title = NULL);
 };
 
-#if defined WINDOWS
-#elif defined LINUX
-struct SemaTex {
-  pthread_mutex_t mutex;
-  pthread_cond_t semaphore;
-};
-#endif
-
 class core_dll SharedLibrary {
 private:
   shared_object library_;
@@ -171,6 +164,7 @@ public:
   static void Sleep(std::chrono::milliseconds ms);
   static void Sleep(std::chrono::system_clock::duration ms) { Sleep(std::chrono::duration_cast<std::chrono::milliseconds>(ms)); }
   static void Sleep(); // inifnite
+  static uint32 Index(); // small number identifying the calling thread, assigned on the first call in the order of calls
   virtual ~Thread();
   void start(thread_function f);
   void suspend();
@@ -199,6 +193,36 @@ public:
   static std::string ToString_year(Timestamp timestamp);    // day_name day_number month year hour:minutes:seconds:milliseconds:microseconds GMT since 01/01/1970.
 };
 
+class core_dll Memory {
+public:
+  static const uint32 CacheLineSize = 64;
+  static const uint32 PageSize = 4096;
+  static const uint32 HugePageSize = 2 * 1024 * 1024;
+  static void *AlignedAllocate(size_t size); // aligned on a cache line; on a page, resp. a huge page (backed by one where supported), when size is at least that large
+  static void AlignedFree(void *p);
+};
+
+class core_dll BlockPool { // process-wide lock-free cache of aligned blocks of a given size, shared by all pipes using that size
+private:
+  static const uint32 Slots = 64;
+  size_t size_;
+  std::atomic<void *> slots_[Slots];
+  std::atomic_uint32_t cached_; // upper bound of the number of filled slots
+  std::atomic_uint32_t cap_;
+  BlockPool *next_; // in the registry
+  BlockPool(size_t size);
+public:
+  static const size_t DefaultCacheBytes = 4 * 1024 * 1024; // per pool; the default cap is DefaultCacheBytes/size blocks, at least 1 and at most Slots
+  static BlockPool *Get(size_t size); // one pool per size, created on first use and kept until the process exits
+  static void TrimAll(uint32 keep = 0); // releases the blocks cached by all pools but keep per pool; to be called periodically to release the memory of idle pipes
+  void *allocate(); // a cached block if any, a new one otherwise
+  void deallocate(void *p); // cached unless the pool is at its cap
+  void trim(uint32 keep = 0);
+  void setCap(uint32 cap); // max number of cached blocks; 0 disables caching
+  uint32 cached() const { return cached_.load(std::memory_order_relaxed); }
+  size_t size() const { return size_; }
+};
+
 class core_dll Host {
 public:
   typedef char host_name[255];
@@ -240,36 +264,30 @@ public:
   void leave();
 };
 
-class core_dll Timer {
-private:
-#if defined WINDOWS
-  timer t_;
-#elif defined LINUX
-  timer_t timer;
-  struct SemaTex sematex;
-#endif
-protected:
-  static const uint32 Infinite;
-public:
-  Timer();
-  ~Timer();
-  void start(std::chrono::microseconds deadline, std::chrono::milliseconds period = std::chrono::seconds(0));   // deadline in us, period in ms.
-  bool wait(uint32 timeout = Infinite);            // timeout in ms; returns true if timedout.
-};
-
+// Manual-reset events stay fired until reset() and release all their waiters; auto-reset events release one waiter and reset.
+// On linux, an event is an eventfd, readable while fired: it can be watched with poll/epoll, after which the owner of an
+// auto-reset event takes it with wait_for(0).
 class core_dll Event {
 private:
 #if defined WINDOWS
   event e_;
 #elif defined LINUX
-  // TODO.
+  int fd_; // eventfd: its counter is non-zero while fired
+  bool manualReset_;
+  bool take(); // returns true if the event was fired, and resets it if auto-reset
 #endif
 public:
-  Event();
+  static const uint32 Infinite;
+  Event(bool manualReset = true);
   ~Event();
   void wait();
+  bool wait_for(uint32 timeout); // timeout in ms; returns true if timedout
   void fire();
   void reset();
+#if defined LINUX
+  int fd() const { return fd_; } // not to be read: use reset() or wait_for(0)
+#endif
+  static int32 WaitAny(Event **events, uint32 count, uint32 timeout = Infinite); // timeout in ms; returns the index of the event taken (the lowest fired), or -1 if timedout
 };
 
 class core_dll SignalHandler {
@@ -292,6 +310,299 @@ public:
   void release();
 };
 
+class Selector;
+
+// Counting semaphore that stays in user space while units are available: threads only sleep
+// on the OS semaphore when the count is exhausted, and release() only wakes them when some sleep.
+// Before sleeping, a thread spins for a while in case a unit is about to be released: the budget adapts
+// to the gaps between releases observed by the semaphore, and is capped by MaxSpin (0 disables spinning).
+class core_dll LightweightSemaphore {
+  friend class Selector;
+private:
+  static std::atomic_uint32_t MaxSpin_;
+  std::atomic_int32_t count_; // available units minus the number of sleeping threads
+  Semaphore s_;
+  std::atomic<Selector *> selector_; // notified on release()
+  std::atomic_int32_t spin_; // current budget, in iterations
+  bool spin(); // returns true if a unit was taken while spinning
+protected:
+  static const uint32 Infinite;
+public:
+  LightweightSemaphore(uint32 initialCount);
+  ~LightweightSemaphore();
+  void acquire();
+  bool acquire(uint32 timeout); // returns true if timedout
+  uint32 acquire(uint32 max, uint32 timeout); // waits for at least one unit and takes up to max; returns 0 if timedout
+  uint32 try_acquire(uint32 max = 1); // takes up to max units; returns 0 if none is available
+  void release(uint32 count = 1); // wakes at most count sleeping threads, with a single release
+  int32 count() const; // negative when threads are sleeping
+
+  static uint32 TimeoutUntil(Timestamp deadline); // ms left until deadline (on the Time::Get() clock), rounded up; 0 if passed
+  static void SetMaxSpin(uint32 iterations); // for all semaphores; defaults to 0 on single core machines
+  static uint32 MaxSpin();
+};
+
+// Waits for any of several pipes (or other lightweight semaphores) and sockets to have data, without polling:
+// the waiting thread checks the sources, then sleeps until a release() on one of them or a socket wakes it up.
+// wait() only reports a ready source: the caller then pops with try_pop(), as other readers may have been faster.
+// Sources are to be added before waiting, by the waiting thread; a semaphore belongs to one selector at a time, and
+// both are to outlive the threads releasing the semaphore. On windows, sockets are switched to non-blocking mode.
+class core_dll Selector {
+private:
+  class Source {
+  public:
+    LightweightSemaphore *semaphore_; // NULL for a socket
+    socket socket_;
+  };
+  std::vector<Source> sources_;
+  uint32 next_; // where the next scan starts, for fairness
+  std::atomic_bool armed_; // the waiting thread is about to sleep
+#if defined WINDOWS
+  semaphore wake_;
+  std::vector<event> events_; // one per socket
+#elif defined LINUX
+  int wake_; // eventfd
+#endif
+  int32 ready(); // index of a ready semaphore; -1 if none
+  bool sleep(uint32 timeout, int32 &index); // index of a ready socket, or -1; returns true if timedout
+public:
+  static const uint32 Infinite;
+  Selector();
+  ~Selector();
+  uint32 add(LightweightSemaphore *s); // returns the index of the source
+  uint32 add(socket s); // ready when readable or closed
+  int32 wait(uint32 timeout = Infinite); // timeout in ms; returns the index of a ready source, or -1 if timedout
+  void notify(); // called on release() by the semaphores added
+};
+
+// Inter-process classes, Linux only: they rest on POSIX shared memory (shm_open), process-shared semaphores and file mappings, and
+// are not declared on Windows. So are SpillPipe and SharedPipe (pipe.h), which are built on them.
+#if defined LINUX
+// Named memory region mapped by several processes (shm_open): created zero-filled, and unlinked when its creator closes it.
+class core_dll SharedMemory {
+private:
+  int fd_;
+  void *base_;
+  size_t size_;
+  std::string name_;
+  bool owner_;
+public:
+  SharedMemory();
+  ~SharedMemory();
+  SharedMemory *create(const char *name, size_t size); // name starts with a '/'; returns NULL if the region exists already, or on error
+  SharedMemory *open(const char *name, size_t size); // returns NULL if the region does not exist or is smaller than size, or on error
+  void close();
+  void *base() const { return base_; }
+  size_t size() const { return size_; }
+};
+
+// Append-only file of fixed-size chunks, read back in order through mappings: the overflow of a SpillPipe.
+class core_dll SpillFile {
+private:
+  int fd_;
+  std::string path_;
+  size_t chunkBytes_;
+  size_t stride_; // chunkBytes_ rounded up to a page, for the mappings
+  uint64 written_; // chunks
+  uint64 read_;
+public:
+  SpillFile();
+  ~SpillFile();
+  SpillFile *open(const char *path, size_t chunkBytes); // creates or truncates the file; returns NULL on error
+  void close(); // removes the file
+  bool append(const void *chunk); // returns false on error, e.g. when the disk is full
+  const void *map(); // the oldest chunk not read yet, to be unmapped when done with; NULL if none, or on error (the chunk stays unread)
+  bool read(void *chunk); // copies the oldest chunk not read yet; returns false if none, or on error (the chunk stays unread)
+  void skip(); // gives up on the oldest chunk not read yet
+  void unmap(const void *chunk);
+  void reset(); // truncates the file, all chunks having been read
+  uint64 chunks() const { return written_ - read_; } // not read yet
+};
+
+// Counting semaphore placed in a SharedMemory region, on a process-shared futex; init() is called once, by the creator.
+class core_dll SharedSemaphore {
+private:
+  std::atomic_int32_t count_;
+  std::atomic_int32_t sleepers_;
+public:
+  static const uint32 Infinite;
+  void init(uint32 initialCount);
+  bool acquire(uint32 timeout = Infinite); // returns true if timedout
+  bool try_acquire();
+  void release(uint32 count = 1);
+  int32 count() const;
+};
+
+// Processes attached to a shared structure, placed in a SharedMemory region: tells if they are still running,
+// including those which died without detaching. Relies on process ids, which the system may reuse after a while.
+class core_dll SharedPeers {
+public:
+  static const uint32 Max = 16;
+private:
+  std::atomic_int32_t ids_[Max]; // 0 for a free entry
+  std::atomic_bool attached_; // at least once
+public:
+  bool attach(); // registers the calling process; returns false if Max processes are attached
+  void detach();
+  uint32 alive(); // number of the attached processes still running; forgets the dead ones
+  bool gone(); // some process attached, and none is left
+};
+#endif
+
+// TimerService, PipeTimeout and PoolTimeout are Linux only (timerfd), and are not declared on Windows, where Timer keeps its
+// waitable timer.
+#if defined LINUX
+typedef void (*timeout_callback)(void *context);
+
+// Timeouts driven by one thread sleeping on a timerfd (CLOCK_MONOTONIC), in a hierarchical timing wheel: 4 levels of 256 slots,
+// whose entries cascade to the level below when the wheel reaches their slot. Arming and cancelling a timeout take constant time,
+// and the thread only wakes up when a slot holds timeouts or has to cascade. Deadlines are rounded up to the tick.
+// Callbacks run on the service's thread, one at a time: they are to be short, and hand longer work to a pipe or a pool
+// (see PipeTimeout and PoolTimeout).
+class core_dll TimerService {
+public:
+  static const uint32 Levels = 4;
+  static const uint32 Slots = 256;
+  class Link {
+  public:
+    Link *next_; // NULL when not linked
+    Link *prev_;
+    Link() : next_(NULL), prev_(NULL) {}
+  };
+  // A timeout to arm; cancelled when destroyed.
+  class core_dll Timeout :
+    public Link {
+    friend class TimerService;
+  private:
+    std::atomic<TimerService *> service_; // armed on, or running on
+    uint64 deadline_; // in ticks
+    uint64 period_; // in ticks; 0 for a one-shot timeout
+    timeout_callback callback_;
+    void *context_;
+  public:
+    Timeout(timeout_callback callback, void *context);
+    ~Timeout();
+    bool armed() const { return next_ != NULL; }
+  };
+private:
+  const uint64 tick_; // in ns
+  uint64 origin_; // CLOCK_MONOTONIC at tick 0, in ns
+  uint64 now_; // the wheel has expired all the timeouts due at this tick
+  uint64 programmed_; // tick the timerfd is set to expire at; UINT64_MAX if disarmed
+  uint32 count_; // timeouts armed
+  Link wheel_[Levels][Slots]; // circular lists: each slot is the head of its own
+  Link expired_; // due, not run yet
+  Timeout *running_; // whose callback is running
+  uint32 index_; // Thread::Index() of the service's thread
+  int fd_; // timerfd
+  std::atomic_bool stop_;
+  CriticalSection cs_;
+  Thread *thread_;
+  static thread_ret thread_function_call Run(void *args);
+  static void Append(Link &list, Link *l);
+  static void Unlink(Link *l);
+  uint64 ticks() const; // ticks elapsed since the origin
+  uint64 insert(Timeout *t); // returns the tick at which the thread has to wake up for t
+  void advance(uint64 to); // moves the due timeouts to expired_
+  uint64 next() const; // next tick at which the wheel has to advance
+  void program(uint64 tick);
+public:
+  TimerService(std::chrono::microseconds tick = std::chrono::milliseconds(1));
+  ~TimerService(); // cancels the timeouts armed
+  static TimerService &Default(); // 1 ms tick, created on first use
+  void arm(Timeout &t, std::chrono::microseconds delay, std::chrono::microseconds period = std::chrono::microseconds(0)); // rearms t if armed; a period of 0 means one-shot
+  void arm_until(Timeout &t, Timestamp deadline, std::chrono::microseconds period = std::chrono::microseconds(0)); // deadline on the Time::Get() clock
+  bool cancel(Timeout &t); // returns true if t was armed; waits for its callback to return if running on another thread
+  uint32 armed(); // number of timeouts armed
+};
+
+// Pushes a copy of an item into a pipe (of any kind, or anything with push(T &)) on expiry.
+template<class P, typename T> class PipeTimeout :
+  public TimerService::Timeout {
+private:
+  P &pipe_;
+  T item_;
+  static void Push(void *context);
+public:
+  PipeTimeout(P &pipe, const T &item) : Timeout(Push, this), pipe_(pipe), item_(item) {}
+};
+
+// Submits a copy of a function to a pool (or anything with submit(F &&)) on expiry.
+template<class E, class F> class PoolTimeout :
+  public TimerService::Timeout {
+private:
+  E &pool_;
+  F f_;
+  static void Submit(void *context);
+public:
+  PoolTimeout(E &pool, const F &f) : Timeout(Submit, this), pool_(pool), f_(f) {}
+};
+#endif
+
+class core_dll Timer {
+private:
+#if defined WINDOWS
+  timer t_;
+#elif defined LINUX
+  Event event_; // auto-reset, as the waitable timer on windows
+  TimerService::Timeout timeout_; // on the default service
+  static void Fire(void *context);
+#endif
+protected:
+  static const uint32 Infinite;
+public:
+  Timer();
+  ~Timer();
+  void start(std::chrono::microseconds deadline, std::chrono::milliseconds period = std::chrono::seconds(0));   // deadline in us, period in ms.
+  bool wait(uint32 timeout = Infinite);            // timeout in ms; returns true if timedout.
+};
+
+class core_dll PipeStats { // instrumentation of a pipe (see WITH_PIPE_STATS in pipe.h); registered until destroyed
+public:
+  static const uint32 Shards = 16; // threads update the shard of their own, unless more threads than shards are running
+  static const uint32 Buckets = 32; // log2 histograms: bucket 0 counts durations under 1 us, bucket i those in [2^(i-1), 2^i) us
+  class Snapshot {
+  public:
+    std::string name_;
+    int32 depth_; // items not yet claimed by a reader
+    int32 highWater_;
+    uint64 pushes_;
+    uint64 pops_;
+    uint64 blocks_; // allocated by the writers
+    uint64 waits_[Buckets]; // time readers slept on an empty pipe
+    uint64 locks_[Buckets]; // time writers waited for a lock
+  };
+private:
+  class alignas(Memory::CacheLineSize) Shard {
+  public:
+    std::atomic<uint64> pushes_;
+    std::atomic<uint64> pops_;
+    std::atomic<uint64> blocks_;
+    std::atomic<uint64> waits_[Buckets];
+    std::atomic<uint64> locks_[Buckets];
+  };
+  const LightweightSemaphore *items_; // the pipe's: its count is the depth
+  std::string name_;
+  std::atomic_int32_t highWater_;
+  Shard shards_[Shards];
+  PipeStats *prev_; // in the registry
+  PipeStats *next_;
+  static uint32 Bucket(uint64 us);
+public:
+  PipeStats(const LightweightSemaphore *items);
+  ~PipeStats();
+  void setName(const std::string &name);
+  void pushed(uint32 n);
+  void popped(uint32 n);
+  void blockAllocated();
+  uint64 waitStart() const; // to be called before acquiring an item: returns 0 unless the reader is about to sleep
+  void waited(uint64 start);
+  void locked(uint64 start);
+  Snapshot snapshot() const;
+  static void SnapshotAll(std::vector<Snapshot> &snapshots); // of all the registered pipes
+  static uint64 Now(); // in us, on the Time::Get() clock
+};
+
 class core_dll String {
 public:
   static int32 StartsWith(const std::string &s, const std::string &str);
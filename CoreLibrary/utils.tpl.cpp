@@ -106,4 +106,19 @@ template<class T> T *Thread::New(thread_function f, void *args) {
   delete t;
   return NULL;
 }
+
+#if defined LINUX
+template<class P, typename T> void PipeTimeout<P, T>::Push(void *context) {
+
+  PipeTimeout *t = (PipeTimeout *)context;
+  T item = t->item_;
+  t->pipe_.push(item);
+}
+
+template<class E, class F> void PoolTimeout<E, F>::Submit(void *context) {
+
+  PoolTimeout *t = (PoolTimeout *)context;
+  t->pool_.submit(F(t->f_));
+}
+#endif
 }